@@ -1,401 +1,4096 @@
-/**
- * @file ReadCSV.hpp
- * @author Ghazal Khalili (khalili.ghazal.97@gmail.com)
- * @brief
- * @version 1.1
- * @date 2021-12-30
- *
- * @copyright Copyright (c) 2021
- *
- */
-
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <string>
-#include <vector>
-#include <cctype>
-#include <cmath>
-#include "matrix.hpp"
-
-using namespace std;
-
-/**
- * @brief Class of csv
- *  to read an input file in csv format.
- * @tparam T type which is usually a double.
- */
-template <typename T>
-class csv
-{
-public:
-    /**
-     * @brief Constructs a new csv object.
-     * Gets the metadata, such as number of rows, number of columns, and header names.
-     * @param _file_name Name of the csv file to read.
-     */
-    csv(const string &);
-
-    /**
-     * @brief Exception to be thrown if the file cannot be opened.
-     */
-    class file_notfound : public invalid_argument
-    {
-    public:
-        file_notfound() : invalid_argument("\nCannot open a file with the given name!\n\n"){};
-    };
-
-    /**
-     * @brief Exception to be thrown if getting the file encounters an error.
-     */
-    class input_failed : public invalid_argument
-    {
-    public:
-        input_failed() : invalid_argument("\nEncountered an error in input!\n\n"){};
-    };
-
-    /**
-     * @brief Exception to be thrown if the file contains empty lines.
-     */
-    class empty_line : public invalid_argument
-    {
-    public:
-        empty_line() : invalid_argument("\nPlease remove the empty line and try again!\n\n"){};
-    };
-
-    /**
-     * @brief Exception to be thrown if the number of columns is less than expected.
-     */
-    class less_column : public out_of_range
-    {
-    public:
-        less_column() : out_of_range("\nExpected less columns!\n\n"){};
-    };
-
-    /**
-     * @brief Exception to be thrown if the number of columns is more than expected.
-     */
-    class more_column : public out_of_range
-    {
-    public:
-        more_column() : out_of_range("\nExpected more columns!\n\n"){};
-    };
-
-    /**
-     * @brief Exception to be thrown if a number value is not valid.
-     */
-    class number_invalid : public invalid_argument
-    {
-    public:
-        number_invalid() : invalid_argument("\nThe number is invalid and cannot be converted!\n\n"){};
-    };
-
-    /**
-     * @brief Reads the data set line by line,
-     * and returns the dataset in matrix format.
-     * @param row_num if true, row numbers are added to the data set.
-     * @return matrix<double> The received dataset.
-     */
-    matrix<T> read_data(bool const &);
-
-    /**
-     * @brief Gets the number of columns.
-     * @return uint64_t NCols.
-     */
-    uint64_t get_NCols() const;
-
-    /**
-     * @brief Gets the number of rows.
-     * @return uint64_t NRows.
-     */
-    uint64_t get_NRows() const;
-
-    /**
-     * @brief Gets the header names.
-     * @return uint64_t headers.
-     */
-    string get_header() const;
-
-    /**
-     * @brief Gets the row numbers.
-     * @return vector<T> containing row numbers.
-     */
-    vector<T> get_row_numbers();
-
-private:
-    /**
-     * @brief Checks whether it is a valid number.
-     * @param value_st The string of the value.
-     * @return True if it is valid.
-     * @return False invalid.
-     */
-    bool is_valid_num(const string &);
-
-    /**
-     * @brief Reads a row of the dataset in csv format.
-     * (columns are separated by comma).
-     * @param line The row of the data set.
-     * @return vector<double> The read row.
-     */
-    vector<T> read_rows(const string &);
-
-    /**
-     * @brief The name of the csv file.
-     */
-    string datafile;
-    /**
-     * @brief Number of columns.
-     */
-    uint64_t NCols = 0;
-    /**
-     * @brief Header (column names, which is the first line).
-     */
-    string headers;
-    /**
-     * @brief Number of rows.
-     */
-    uint64_t NRows = 0;
-    /**
-     * @brief Length of the header line.
-     */
-    uint64_t NChar;
-    /**
-     * @brief A vector to save the row numbers.
-     */
-    vector<T> Row_numbers;
-    /**
-     * @brief A vector to save the data set used in converting it into a matrix.
-     */
-    vector<T> Matrix_elements;
-};
-
-// ==============
-// Implementation
-// ==============
-
-template <typename T>
-csv<T>::csv(const string &_file_name) : datafile(_file_name)
-{
-    // Reading the data
-    ifstream input(datafile);
-    if (!input.is_open())
-    {
-        cout << "File \"" << datafile << "\": ";
-        throw typename csv::file_notfound();
-    }
-    // Finding number of the columns and saving the headers
-    getline(input, headers);
-    string line;
-    istringstream string_stream(headers);
-    NChar = headers.size() + 2; // Number of the characters in line 1 (headers) + 2 characters of "\n"
-    while (getline(string_stream, line, ','))
-    {
-        NCols++; // Updating the number of columns
-    }
-
-    // Finding the number of rows
-    // The first row was the headers (column names), so we make sure to read the data from the second row
-    input.seekg(NChar, ios::beg);
-    while (getline(input, line))
-    {
-        // Stopping on the empty lines
-        if (line.size() == 2) // The "\n" at the end of each line is 2 characters in length
-        {
-            cout << "\nNotice: Line number " << NRows + 1 << " is empty. \n";
-            throw typename csv::empty_line();
-        }
-        NRows++;
-    }
-    if (input.eof())
-    {
-        cout << "\nData file is successfully received\n";
-    }
-    else if (input.fail())
-    {
-        input.close();
-        throw typename csv::input_failed();
-    }
-    input.close();
-}
-
-template <typename T>
-bool csv<T>::is_valid_num(const string &value_st)
-{
-    // Breaking down the string to characters
-    vector<char> c_in_str(value_st.c_str(), value_st.c_str() + value_st.size() + 1);
-    uint64_t size = c_in_str.size() - 1;
-
-    uint64_t dot = 0;
-    for (uint64_t i = 0; i < size; i++)
-    {
-        if (c_in_str[i] == ' ')
-        {
-            continue;
-        }
-        if (c_in_str[i] == '.') // The number is allowed to have only one decimal point
-        {
-            dot++;
-            if (dot > 1)
-            {
-                return false;
-            }
-            continue;
-        }
-        if (i == 0 && c_in_str[i] == '-') // In case of a negative number, skips the minus sign in the begining only
-        {
-            continue;
-        }
-        // The other characters should be only digits
-        if (isdigit(c_in_str[i]) == 0)
-        {
-            return false;
-        }
-    }
-    return true;
-}
-
-template <typename T>
-vector<T> csv<T>::read_rows(const string &line)
-{
-    vector<T> v;    // The vector for saving the data
-    uint64_t j = 0; // Number of columns read for each row
-    istringstream string_stream(line);
-    string column;
-
-    // Extracting values of the columns from each row
-    while (getline(string_stream, column, ','))
-    {
-        j++;           // Updating the size
-        if (j > NCols) // As soon as it gets more than the limit, it stops
-        {
-            throw typename csv::less_column();
-        }
-        // Checking whether it is a number
-        if (is_valid_num(column))
-        {
-            // Adding the number to our vector
-            try
-            {
-                v.push_back(stod(column));
-            }
-            catch (const exception &e)
-            {
-                throw typename csv::number_invalid();
-            }
-        }
-        else
-        {
-            throw typename csv::number_invalid();
-        }
-    }
-    // Checking whether the the number of read values is correct (equals the number of columns)
-    if (j < NCols)
-    {
-        throw typename csv::more_column();
-    }
-    return v;
-}
-
-template <typename T>
-matrix<T> csv<T>::read_data(bool const &row_num)
-{
-    // To start reading the data again
-    ifstream input(datafile);
-    if (!input.is_open())
-    {
-        throw typename csv::file_notfound();
-    }
-
-    input.seekg(NChar, ios::beg); // Skipping the headers line
-    Matrix_elements.clear();
-    if (row_num == true)
-    {
-        Matrix_elements.reserve(NRows * (NCols + 1));
-    }
-    else
-    {
-        Matrix_elements.reserve(NRows * NCols);
-    }
-    Row_numbers = vector<T>(NRows);
-    uint64_t i = 0;
-    vector<T> v(NCols); // A vector to get the output
-    string line;
-    cout << "Started reading the data: ";
-    while (getline(input, line))
-    {
-        v = read_rows(line);
-        if (row_num == true)
-        {
-            Row_numbers[i] = (T)(i + 1);
-            Matrix_elements.insert(Matrix_elements.begin() + i * (NCols + 1), Row_numbers[i]);
-            Matrix_elements.insert(Matrix_elements.begin() + i * (NCols + 1) + 1, v.begin(), v.end());
-        }
-        else
-        {
-            Matrix_elements.insert(Matrix_elements.begin() + i * NCols, v.begin(), v.end());
-        }
-        // Printing the progress
-        if (NRows >= 10)
-        {
-            //(with 10% step size)
-            if (i % ((uint64_t)round((double)NRows * 0.1)) == 0)
-            {
-                cout << "*";
-            }
-        }
-        else
-        {
-            cout << "*";
-        }
-        i++;
-    }
-    if (input.eof())
-    {
-        cout << "\nReached end of the file.\n + All the rows are received successfully.\n\n";
-    }
-    else if (input.fail())
-    {
-        input.close();
-        throw typename csv::input_failed();
-    }
-    input.close();
-    // Saving the data set into a matrix
-    if (row_num == true)
-    {
-        matrix<T> DataSet(NRows, (NCols + 1), Matrix_elements);
-        return DataSet;
-    }
-    else
-    {
-        matrix<T> DataSet(NRows, NCols, Matrix_elements);
-        return DataSet;
-    }
-}
-
-template <typename T>
-inline uint64_t csv<T>::get_NCols() const
-{
-    return NCols;
-}
-
-template <typename T>
-inline uint64_t csv<T>::get_NRows() const
-{
-    return NRows;
-}
-
-template <typename T>
-inline string csv<T>::get_header() const
-{
-    return headers;
-}
-
-template <typename T>
-inline vector<T> csv<T>::get_row_numbers()
-{
-    return Row_numbers;
-}
-
-// ==========================
-// End of CSV Implementation
+/**
+ * @file ReadCSV.hpp
+ * @author Ghazal Khalili (khalili.ghazal.97@gmail.com)
+ * @brief
+ * @version 1.1
+ * @date 2021-12-30
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <variant>
+#include <unordered_map>
+#include <exception>
+#include <algorithm>
+#include <bit>
+#include <span>
+#include <iterator>
+#include <filesystem>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <cstring>
+#include <charconv>
+#include <system_error>
+#include <cerrno>
+#include <type_traits>
+#include <chrono>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if (defined(__x86_64__) or defined(__i386__)) and defined(__GNUC__)
+#include <immintrin.h>
+#define READCSV_X86_SIMD
+#endif
+// Compressed inputs are read when the program is built with these (and linked with -lz or -lzstd)
+#ifdef READCSV_USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef READCSV_USE_ZSTD
+#include <zstd.h>
+#endif
+#include "matrix.hpp"
+
+using namespace std;
+
+/**
+ * @brief How the csv file is brought into memory.
+ */
+enum class load_mode
+{
+    /**
+     * @brief The constructor counts the rows, and read_data() reads the file again through a stream.
+     */
+    stream,
+    /**
+     * @brief The file is memory-mapped once; rows are found and parsed in a single pass by read_data().
+     */
+    mapped
+};
+
+/**
+ * @brief The format of the fields of a csv file. The lines may end with "\n" or "\r\n" in any dialect.
+ */
+struct csv_dialect
+{
+    /**
+     * @brief The character separating the columns, such as ',', '\t', ';' or '|'.
+     */
+    char delimiter = ',';
+    /**
+     * @brief The character quoting a field that contains the delimiter ('\0' means fields are not quoted).
+     * In a quoted field, two quotes in a row stand for one. Quoted fields cannot contain line breaks.
+     */
+    char quote = '\0';
+    /**
+     * @brief If true, the spaces and tabs around every field (and column name) are removed.
+     * Numbers are always read without the spaces around them.
+     */
+    bool trim = false;
+};
+
+/**
+ * @brief What the parser does with a row that cannot be read (see csv_options::errors).
+ */
+enum class error_mode
+{
+    /**
+     * @brief The first row that cannot be read throws an exception, and nothing is returned.
+     */
+    strict,
+    /**
+     * @brief The rows that cannot be read are left out of the data set, and recorded in the error log.
+     */
+    skip_row,
+    /**
+     * @brief The cells that cannot be read are set to csv_options::fill_value, and the rows are recorded in the error log.
+     */
+    fill
+};
+
+/**
+ * @brief The problems found in a row.
+ */
+enum class error_kind
+{
+    /**
+     * @brief The line is empty.
+     */
+    empty_line,
+    /**
+     * @brief The row has more columns than the header (the extra ones are ignored when the row is filled).
+     */
+    less_column,
+    /**
+     * @brief The row has fewer columns than the header.
+     */
+    more_column,
+    /**
+     * @brief A value is not a valid number.
+     */
+    number_invalid
+};
+
+/**
+ * @brief A row that could not be read, recorded in the error log of a csv object.
+ */
+struct parse_error
+{
+    /**
+     * @brief The row (starting from 1, without the header, as in the row numbers).
+     */
+    uint64_t row = 0;
+    /**
+     * @brief The column of the first invalid value in the file (starting from 0), or UINT64_MAX if it is not about one column.
+     */
+    uint64_t column = UINT64_MAX;
+    /**
+     * @brief Where the row starts in the file (in the decompressed text for a compressed file).
+     */
+    uint64_t offset = 0;
+    /**
+     * @brief The first problem found in the row.
+     */
+    error_kind kind = error_kind::number_invalid;
+};
+
+/**
+ * @brief Options given to the csv constructor.
+ */
+struct csv_options
+{
+    /**
+     * @brief How the file is loaded (see load_mode).
+     */
+    load_mode mode = load_mode::stream;
+    /**
+     * @brief Number of threads parsing the rows in read_data() (0 means all hardware threads).
+     * With more than one thread, the file is mapped and split into chunks of whole lines.
+     */
+    uint64_t threads = 1;
+    /**
+     * @brief Number of blocks (of 1 MB) read ahead of the parsing by a separate thread when the file is read
+     * through a stream (0 means the file is read by the parsing thread itself).
+     * Overlapping the reads with the parsing helps most on slow, cold-cache or network storage.
+     */
+    uint64_t prefetch = 0;
+    /**
+     * @brief The format of the fields (comma-separated and not quoted by default).
+     */
+    csv_dialect dialect;
+    /**
+     * @brief If true, the dialect is found by the constructor from the first 64 KB of the file, instead of given.
+     */
+    bool sniff = false;
+    /**
+     * @brief What the parser does with a row that cannot be read (an exception by default).
+     * The cache is not used in the other modes.
+     */
+    error_mode errors = error_mode::strict;
+    /**
+     * @brief The value of the cells that cannot be read in error_mode::fill, converted to T
+     * (NaN by default, which is the largest value of T for integer types).
+     */
+    double fill_value = numeric_limits<double>::quiet_NaN();
+    /**
+     * @brief The number of errors kept in the error log (the others are only counted).
+     */
+    uint64_t max_errors = 1000;
+    /**
+     * @brief Names of the columns to read, in the order they should appear in the result (empty means all the columns).
+     */
+    vector<string> columns;
+    /**
+     * @brief Indices of the columns to read (starting from 0), placed after the columns selected by name.
+     */
+    vector<uint64_t> column_indices;
+    /**
+     * @brief Names of selected columns holding text, such as categories, which are dictionary-encoded:
+     * every distinct value gets a dense code (0, 1, 2, ... in order of first appearance), stored as T in the result.
+     * The values of the codes are given by csv::get_dictionary(). The cache is not used with encoded columns.
+     */
+    vector<string> encode_columns;
+    /**
+     * @brief If above 0, the row count also records where every index_step-th row starts in the file
+     * (8 bytes for every index_step rows), so csv::get_rows() seeks straight to the rows it needs.
+     */
+    uint64_t index_step = 0;
+    /**
+     * @brief If true, the row index is saved next to the csv file (with ".index" appended to its name),
+     * and later constructors load it instead of counting the rows, as long as the csv file has not changed.
+     */
+    bool index_file = false;
+    /**
+     * @brief If true, the parsed data set is saved in a binary cache file next to the csv file,
+     * and later loads take it from there (without parsing) as long as the csv file has not changed.
+     */
+    bool cache = false;
+    /**
+     * @brief Name of the cache file (empty means the name of the csv file followed by ".cache").
+     */
+    string cache_file;
+};
+
+/**
+ * @brief Stages of loading a data set, reported to the observer of a csv object.
+ */
+enum class load_stage
+{
+    /**
+     * @brief The constructor: reading the header, and counting the rows (in load_mode::stream).
+     */
+    open,
+    /**
+     * @brief Finding and parsing the rows (read_data(), read_columns(), read_table() and batches()).
+     */
+    parse,
+    /**
+     * @brief Reading the data set from the binary cache.
+     */
+    cache_load,
+    /**
+     * @brief Writing the binary cache.
+     */
+    cache_save
+};
+
+/**
+ * @brief Progress of a stage, given to the observer of a csv object.
+ */
+struct load_progress
+{
+    /**
+     * @brief The stage being reported.
+     */
+    load_stage stage = load_stage::open;
+    /**
+     * @brief Bytes of the (decompressed) file handled so far in the stage.
+     */
+    uint64_t bytes = 0;
+    /**
+     * @brief Bytes the stage will handle in total (0 if it is not known in advance, such as for a compressed file).
+     */
+    uint64_t total_bytes = 0;
+    /**
+     * @brief Rows handled so far in the stage.
+     */
+    uint64_t rows = 0;
+    /**
+     * @brief Time since the beginning of the stage, in seconds.
+     */
+    double seconds = 0;
+
+    /**
+     * @brief Gets the rate of the stage in bytes per second.
+     */
+    double bytes_per_second() const { return (seconds > 0) ? (double)bytes / seconds : 0; }
+
+    /**
+     * @brief Gets the rate of the stage in rows per second.
+     */
+    double rows_per_second() const { return (seconds > 0) ? (double)rows / seconds : 0; }
+};
+
+/**
+ * @brief The default observer of a csv object, which ignores everything.
+ * With it, the reports are removed at compile time and cost nothing.
+ * An observer is any class with the same three member functions; for example, one that exports load metrics.
+ * They are called on the thread that called the csv member function. The progress of a stage is reported
+ * every 65536 rows (every batch in csv::batches()), and once more at its end; the threaded parser reports only its end.
+ */
+struct null_observer
+{
+    /**
+     * @brief Called when a stage begins.
+     */
+    void stage_begin(const load_stage &) {}
+
+    /**
+     * @brief Called during a stage, with its progress so far.
+     */
+    void stage_progress(const load_progress &) {}
+
+    /**
+     * @brief Called when a stage ends successfully, with its totals and duration.
+     */
+    void stage_end(const load_progress &) {}
+};
+
+/**
+ * @brief An observer that prints the progress on the console, as the earlier versions of the library did:
+ * a message when the file is received, and a star for every 10% of the rows parsed.
+ */
+class console_observer
+{
+public:
+    /**
+     * @brief Prints on the given stream (cout by default).
+     */
+    explicit console_observer(ostream &_output = cout) : output(&_output) {}
+
+    void stage_begin(const load_stage &stage)
+    {
+        stars = 0;
+        if (stage == load_stage::parse)
+            *output << "Started reading the data: ";
+        else if (stage == load_stage::cache_load)
+            *output << "Started reading the data from the cache: ";
+    }
+
+    void stage_progress(const load_progress &progress)
+    {
+        if (progress.stage != load_stage::parse)
+            return;
+        // A star for every 10% of the file, or for every report if the size is not known
+        uint64_t due = (progress.total_bytes > 0) ? progress.bytes * 10 / progress.total_bytes : stars + 1;
+        for (; stars < min<uint64_t>(due, 10); stars++)
+            *output << "*";
+    }
+
+    void stage_end(const load_progress &progress)
+    {
+        switch (progress.stage)
+        {
+        case load_stage::open:
+            *output << "\nData file is successfully received\n";
+            break;
+        case load_stage::parse:
+            stage_progress(progress);
+            *output << "\nReached end of the file.\n + All the rows are received successfully.\n\n";
+            break;
+        case load_stage::cache_load:
+            *output << "*\nReached end of the cache.\n + All the rows are received successfully.\n\n";
+            break;
+        case load_stage::cache_save:
+            break;
+        }
+    }
+
+private:
+    ostream *output;
+    uint64_t stars = 0;
+};
+
+namespace csv_detail
+{
+    /**
+     * @brief Read-only memory mapping of a whole file.
+     */
+    class mapped_file
+    {
+    public:
+        /**
+         * @brief Maps the file with the given name.
+         * @param file_name Name of the file to map.
+         */
+        explicit mapped_file(const string &);
+        ~mapped_file();
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        /**
+         * @brief Checks whether the file could be opened and mapped.
+         */
+        bool is_open() const { return opened; }
+
+        /**
+         * @brief Gets the first character of the file.
+         */
+        const char *data() const { return first; }
+
+        /**
+         * @brief Gets the size of the file in bytes.
+         */
+        uint64_t size() const { return length; }
+
+    private:
+        const char *first = nullptr;
+        uint64_t length = 0;
+        bool opened = false;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#endif
+    };
+
+#ifdef _WIN32
+    inline mapped_file::mapped_file(const string &file_name)
+    {
+        file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size))
+            return;
+        length = (uint64_t)file_size.QuadPart;
+        opened = true;
+        if (length == 0) // An empty file cannot be mapped, but it is still a valid (empty) input
+            return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr)
+        {
+            opened = false;
+            return;
+        }
+        first = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        opened = (first != nullptr);
+    }
+
+    inline mapped_file::~mapped_file()
+    {
+        if (first != nullptr)
+            UnmapViewOfFile(first);
+        if (mapping != nullptr)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+    }
+#else
+    inline mapped_file::mapped_file(const string &file_name)
+    {
+        int fd = open(file_name.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            close(fd);
+            return;
+        }
+        length = (uint64_t)info.st_size;
+        opened = true;
+        if (length > 0) // An empty file cannot be mapped, but it is still a valid (empty) input
+        {
+            void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED)
+                opened = false;
+            else
+            {
+                first = (const char *)address;
+                madvise(address, length, MADV_SEQUENTIAL); // We walk the file once from the beginning to the end
+            }
+        }
+        close(fd); // The mapping stays valid after closing the descriptor
+    }
+
+    inline mapped_file::~mapped_file()
+    {
+        if (first != nullptr)
+            munmap((void *)first, length);
+    }
+#endif
+
+    /**
+     * @brief Positions of the structural characters in a block of 64 characters.
+     * Bit i is set if character i of the block is a delimiter (or a newline, or a quote).
+     */
+    struct structural_masks
+    {
+        uint64_t delimiters = 0;
+        uint64_t newlines = 0;
+        uint64_t quotes = 0;
+    };
+
+    /**
+     * @brief A kernel finding the structural characters in a block of 64 characters.
+     */
+    using block_scanner = structural_masks (*)(const char *, char, char);
+
+    /**
+     * @brief Scalar kernel, used when the processor has no supported vector instructions.
+     */
+    inline structural_masks scan_block_scalar(const char *block, char delimiter, char quote)
+    {
+        structural_masks masks;
+        for (uint64_t i = 0; i < 64; i++)
+        {
+            masks.delimiters |= (uint64_t)(block[i] == delimiter) << i;
+            masks.newlines |= (uint64_t)(block[i] == '\n') << i;
+            masks.quotes |= (uint64_t)(block[i] == quote) << i;
+        }
+        return masks;
+    }
+
+#ifdef READCSV_X86_SIMD
+    /**
+     * @brief SSE2 kernel, comparing four vectors of 16 characters.
+     */
+    __attribute__((target("sse2"))) inline structural_masks scan_block_sse2(const char *block, char delimiter, char quote)
+    {
+        const __m128i delimiter_v = _mm_set1_epi8(delimiter);
+        const __m128i newline_v = _mm_set1_epi8('\n');
+        const __m128i quote_v = _mm_set1_epi8(quote);
+        structural_masks masks;
+        for (uint64_t i = 0; i < 64; i += 16)
+        {
+            __m128i chars = _mm_loadu_si128((const __m128i *)(block + i));
+            masks.delimiters |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, delimiter_v)) << i;
+            masks.newlines |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, newline_v)) << i;
+            masks.quotes |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, quote_v)) << i;
+        }
+        return masks;
+    }
+
+    /**
+     * @brief AVX2 kernel, comparing two vectors of 32 characters.
+     */
+    __attribute__((target("avx2"))) inline structural_masks scan_block_avx2(const char *block, char delimiter, char quote)
+    {
+        const __m256i delimiter_v = _mm256_set1_epi8(delimiter);
+        const __m256i newline_v = _mm256_set1_epi8('\n');
+        const __m256i quote_v = _mm256_set1_epi8(quote);
+        __m256i low = _mm256_loadu_si256((const __m256i *)block);
+        __m256i high = _mm256_loadu_si256((const __m256i *)(block + 32));
+        structural_masks masks;
+        masks.delimiters = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, delimiter_v)) |
+                           (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, delimiter_v)) << 32;
+        masks.newlines = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, newline_v)) |
+                         (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, newline_v)) << 32;
+        masks.quotes = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, quote_v)) |
+                       (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, quote_v)) << 32;
+        return masks;
+    }
+#endif
+
+    /**
+     * @brief Chooses the fastest kernel supported by the processor.
+     */
+    inline block_scanner select_scanner()
+    {
+#ifdef READCSV_X86_SIMD
+        if (__builtin_cpu_supports("avx2"))
+            return scan_block_avx2;
+        if (__builtin_cpu_supports("sse2"))
+            return scan_block_sse2;
+#endif
+        return scan_block_scalar;
+    }
+
+    /**
+     * @brief Finds the structural characters in the 64 characters starting at block.
+     * The kernel is chosen once, the first time it is called.
+     * @param block The first of the 64 characters (all of them must be readable).
+     * @param delimiter The character separating the columns.
+     * @param quote The character quoting a field ('\0' if fields are not quoted).
+     */
+    inline structural_masks scan_block(const char *block, char delimiter, char quote = '\0')
+    {
+        static const block_scanner scanner = select_scanner();
+        return scanner(block, delimiter, quote);
+    }
+
+    /**
+     * @brief Finds the structural characters in up to 64 characters, which may be fewer than a whole block.
+     * @param first The first character.
+     * @param n Number of characters to scan (the bits after them are zero).
+     * @param delimiter The character separating the columns.
+     * @param quote The character quoting a field ('\0' if fields are not quoted).
+     */
+    inline structural_masks scan_partial_block(const char *first, uint64_t n, char delimiter, char quote = '\0')
+    {
+        if (n >= 64)
+            return scan_block(first, delimiter, quote);
+        char block[64] = {}; // Zeros match neither the delimiter nor a newline
+        memcpy(block, first, n);
+        structural_masks masks = scan_block(block, delimiter, quote);
+        masks.quotes &= (n == 0) ? 0 : UINT64_MAX >> (64 - n); // Zeros match an unused quote character
+        return masks;
+    }
+
+    /**
+     * @brief Counts the lines of a text in memory with the scanner, 64 characters at a time.
+     * A last line without a line break is counted as well.
+     * @param first The first character.
+     * @param last The end of the text.
+     */
+    inline uint64_t count_lines(const char *first, const char *last)
+    {
+        uint64_t lines = 0;
+        const char *block = first;
+        for (; block + 64 <= last; block += 64)
+            lines += (uint64_t)popcount(scan_block(block, ',').newlines);
+        lines += (uint64_t)popcount(scan_partial_block(block, (uint64_t)(last - block), ',').newlines);
+        if (last > first and last[-1] != '\n')
+            lines++;
+        return lines;
+    }
+
+    /**
+     * @brief Marks the characters between quotes: bit i is set if an odd number of quotes come up to character i,
+     * with the prefix XOR of the quote mask (computed without branches, doubled quotes cancel out).
+     * @param quotes The positions of the quotes in a block.
+     * @param inside All ones if the block starts inside quotes, otherwise zero (updated for the next block).
+     */
+    inline uint64_t quoted_mask(uint64_t quotes, uint64_t &inside)
+    {
+        quotes ^= quotes << 1;
+        quotes ^= quotes << 2;
+        quotes ^= quotes << 4;
+        quotes ^= quotes << 8;
+        quotes ^= quotes << 16;
+        quotes ^= quotes << 32;
+        quotes ^= inside;
+        inside = (uint64_t)((int64_t)quotes >> 63);
+        return quotes;
+    }
+
+    /**
+     * @brief Gets the text of a field in a dialect: without the spaces around it (if Trim),
+     * and without its quotes (if Quoted), where two quotes in a row stand for one.
+     * @param value The field as it is in the line.
+     * @param quote The quote character.
+     * @param scratch Where the text is unescaped, if it has doubled quotes.
+     */
+    template <bool Quoted, bool Trim>
+    string_view field_text(string_view value, const char &quote, string &scratch)
+    {
+        if constexpr (Trim)
+        {
+            while (!value.empty() and (value.front() == ' ' or value.front() == '\t'))
+                value.remove_prefix(1);
+            while (!value.empty() and (value.back() == ' ' or value.back() == '\t'))
+                value.remove_suffix(1);
+        }
+        if constexpr (Quoted)
+        {
+            if (value.size() >= 2 and value.front() == quote and value.back() == quote)
+            {
+                value = value.substr(1, value.size() - 2);
+                if (value.find(quote) != string_view::npos)
+                {
+                    scratch.clear();
+                    for (uint64_t k = 0; k < value.size(); k++)
+                    {
+                        scratch += value[k];
+                        if (value[k] == quote and k + 1 < value.size() and value[k + 1] == quote)
+                            k++;
+                    }
+                    value = scratch;
+                }
+            }
+        }
+        return value;
+    }
+
+    /**
+     * @brief Splits a line into fields, finding the delimiters 64 characters at a time.
+     * Each dialect has its own instantiation, so the loop has no branches for the features it does not use.
+     * As with getline(), a field after the last delimiter is only given if it is not empty.
+     * @tparam Quoted Whether delimiters between quotes are part of a field.
+     * @tparam Trim Whether the spaces and tabs around a field are removed.
+     * @param line The line, without its line break.
+     * @param delimiter The character separating the fields.
+     * @param quote The quote character (if Quoted).
+     * @param field Called with the text of every field.
+     */
+    template <bool Quoted, bool Trim, typename F>
+    void split_fields(string_view line, const char &delimiter, const char &quote, const F &field)
+    {
+        uint64_t start = 0; // Where the current field starts in the line
+        uint64_t inside = 0;
+        string scratch;
+        for (uint64_t block = 0; block < line.size(); block += 64)
+        {
+            structural_masks masks = scan_partial_block(line.data() + block, line.size() - block, delimiter, Quoted ? quote : '\0');
+            uint64_t delimiters = masks.delimiters;
+            if constexpr (Quoted)
+            {
+                delimiters &= ~quoted_mask(masks.quotes, inside);
+            }
+            while (delimiters != 0)
+            {
+                uint64_t end = block + (uint64_t)countr_zero(delimiters);
+                field(field_text<Quoted, Trim>(line.substr(start, end - start), quote, scratch));
+                start = end + 1;
+                delimiters &= delimiters - 1;
+            }
+        }
+        if (start < line.size())
+        {
+            field(field_text<Quoted, Trim>(line.substr(start), quote, scratch));
+        }
+    }
+
+    /**
+     * @brief Splits a line into fields with the instantiation of split_fields() for a dialect.
+     */
+    template <typename F>
+    void for_each_field(string_view line, const csv_dialect &dialect, const F &field)
+    {
+        if (dialect.quote == '\0')
+        {
+            if (dialect.trim)
+                split_fields<false, true>(line, dialect.delimiter, dialect.quote, field);
+            else
+                split_fields<false, false>(line, dialect.delimiter, dialect.quote, field);
+        }
+        else
+        {
+            if (dialect.trim)
+                split_fields<true, true>(line, dialect.delimiter, dialect.quote, field);
+            else
+                split_fields<true, false>(line, dialect.delimiter, dialect.quote, field);
+        }
+    }
+
+    /**
+     * @brief Checks whether a field is a valid number and converts it in the same pass.
+     * Spaces around the number are ignored.
+     * Integers are read exactly (unsigned types reject a minus sign, and overflow is an error); a decimal point
+     * followed only by zeros, as in "1.0" or "5.", still holds an integer, but other decimals are invalid.
+     * Floating-point numbers are read in fixed notation: an optional minus sign, digits and one decimal point.
+     * @param field The text of the field.
+     * @param value Where the number is written.
+     * @return True if it is valid.
+     * @return False invalid.
+     */
+    template <typename V>
+    bool parse_number(string_view field, V &value)
+    {
+        while (!field.empty() and field.front() == ' ')
+            field.remove_prefix(1);
+        while (!field.empty() and field.back() == ' ')
+            field.remove_suffix(1);
+        const char *first = field.data();
+        const char *last = field.data() + field.size();
+        from_chars_result result;
+        if constexpr (is_integral_v<V>)
+        {
+            const char *point = find(first, last, '.');
+            if (point != last and all_of(point + 1, last, [](const char &c)
+                                         { return c == '0'; }))
+            {
+                if (point == first)
+                {
+                    value = 0; // ".0"
+                    return point + 1 != last;
+                }
+                last = point;
+            }
+            result = from_chars(first, last, value);
+        }
+        else
+        {
+            // from_chars also accepts "inf" and "nan", so the number must start with a digit or a decimal point
+            const char *digits = (first != last and *first == '-') ? first + 1 : first;
+            if (digits == last or (isdigit((unsigned char)*digits) == 0 and *digits != '.'))
+                return false;
+            result = from_chars(first, last, value, chars_format::fixed);
+        }
+        return result.ec == errc() and result.ptr == last;
+    }
+
+    /**
+     * @brief The result of reading a row: its first problem, if it has one.
+     */
+    struct row_status
+    {
+        bool valid = true;
+        error_kind kind = error_kind::number_invalid;
+        uint64_t column = UINT64_MAX; // The column of the first invalid value in the file
+        uint64_t fields = 0;          // Number of fields in the row
+    };
+
+    /**
+     * @brief The beginning of a binary cache file.
+     * It is followed by the header line of the csv file, and then (at a multiple of 64 bytes)
+     * by the values of the selected columns in row-major order, without row numbers.
+     */
+    struct cache_header
+    {
+        char magic[8] = {'C', 'S', 'V', 'C', 'A', 'C', 'H', '1'};
+        uint64_t value_size = 0;     // sizeof(T)
+        uint64_t value_kind = 0;     // 0: signed integer, 1: unsigned integer, 2: floating point, 3: other
+        uint64_t source_size = 0;    // Size of the csv file in bytes
+        int64_t source_time = 0;     // Last modification time of the csv file
+        uint64_t source_hash = 0;    // Hash of the beginning and the end of the csv file
+        uint64_t selection_hash = 0; // Hash of the selected columns
+        uint64_t NRows = 0;
+        uint64_t NCols = 0;
+        uint64_t NSelected = 0;
+        uint64_t NChar = 0;
+        uint64_t header_size = 0;
+    };
+
+    /**
+     * @brief Layout of the beginning of a row index file; the offsets of the indexed rows follow it.
+     */
+    struct index_header
+    {
+        char magic[8] = {'C', 'S', 'V', 'I', 'N', 'D', 'X', '1'};
+        uint64_t source_size = 0; // Size of the csv file in bytes
+        int64_t source_time = 0;  // Last modification time of the csv file
+        uint64_t source_hash = 0; // Hash of the beginning and the end of the csv file
+        uint64_t NChar = 0;
+        uint64_t NRows = 0;
+        uint64_t step = 0;
+        uint64_t NOffsets = 0;
+    };
+
+    /**
+     * @brief Gets the position of the values in a cache file.
+     * @param header_size Length of the header line saved in the cache.
+     */
+    inline uint64_t cache_payload_offset(const uint64_t &header_size)
+    {
+        return (sizeof(cache_header) + header_size + 63) / 64 * 64;
+    }
+
+    /**
+     * @brief Adds some bytes to a 64-bit FNV-1a hash.
+     * @param hash The hash so far.
+     * @param first The first byte.
+     * @param n Number of bytes.
+     */
+    inline uint64_t fnv1a(uint64_t hash, const char *first, const uint64_t &n)
+    {
+        for (uint64_t i = 0; i < n; i++)
+        {
+            hash ^= (unsigned char)first[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Gets the size, the modification time, and a hash of a file.
+     * Only the first and the last 64 KB are hashed, so it is cheap even for large files;
+     * together with the size and the time, it tells whether the file has changed.
+     * @return False if the file cannot be read.
+     */
+    inline bool fingerprint(const string &file_name, uint64_t &size, int64_t &time, uint64_t &hash)
+    {
+        error_code error;
+        size = (uint64_t)filesystem::file_size(file_name, error);
+        if (error)
+            return false;
+        time = (int64_t)filesystem::last_write_time(file_name, error).time_since_epoch().count();
+        if (error)
+            return false;
+        ifstream input(file_name, ios::binary);
+        if (!input.is_open())
+            return false;
+        const uint64_t window = 1 << 16;
+        vector<char> buffer(window);
+        hash = fnv1a(14695981039346656037ULL, (const char *)&size, sizeof(size));
+        input.read(buffer.data(), (streamsize)window);
+        hash = fnv1a(hash, buffer.data(), (uint64_t)input.gcount());
+        if (size > window)
+        {
+            input.clear();
+            input.seekg((streamoff)(size - window), ios::beg);
+            input.read(buffer.data(), (streamsize)window);
+            hash = fnv1a(hash, buffer.data(), (uint64_t)input.gcount());
+        }
+        return !input.bad();
+    }
+
+    /**
+     * @brief Gets a hash of the first n bytes of a file, from its first and its last 64 KB
+     * (together with n, it tells cheaply whether that part of the file has changed).
+     * @return uint64_t The hash (0 if the file is shorter than n bytes or cannot be read).
+     */
+    inline uint64_t prefix_hash(const string &file_name, const uint64_t &n)
+    {
+        ifstream input(file_name, ios::binary);
+        error_code error;
+        uint64_t size = (uint64_t)filesystem::file_size(file_name, error);
+        if (!input.is_open() or error or size < n)
+            return 0;
+        const uint64_t window = 1 << 16;
+        vector<char> buffer(window);
+        uint64_t hash = fnv1a(14695981039346656037ULL, (const char *)&n, sizeof(n));
+        input.read(buffer.data(), (streamsize)min(window, n));
+        hash = fnv1a(hash, buffer.data(), (uint64_t)input.gcount());
+        if (n > window)
+        {
+            input.seekg((streamoff)(n - window), ios::beg);
+            input.read(buffer.data(), (streamsize)window);
+            hash = fnv1a(hash, buffer.data(), (uint64_t)input.gcount());
+        }
+        return input.bad() ? 0 : (hash == 0 ? 1 : hash);
+    }
+
+    /**
+     * @brief Hash of strings that also takes string views, so a lookup does not copy the key.
+     */
+    struct string_hash
+    {
+        using is_transparent = void;
+        size_t operator()(string_view value) const { return hash<string_view>()(value); }
+    };
+
+    /**
+     * @brief Dictionary of a text column: maps every distinct value to a dense code, in order of first appearance.
+     */
+    class dictionary
+    {
+    public:
+        /**
+         * @brief Gets the code of a value, adding it to the dictionary the first time it is seen.
+         */
+        uint64_t encode(string_view value)
+        {
+            auto found = codes.find(value);
+            if (found != codes.end())
+                return found->second;
+            uint64_t code = values.size();
+            values.emplace_back(value);
+            codes.emplace(values.back(), code);
+            return code;
+        }
+
+        /**
+         * @brief Gets the values, indexed by their codes.
+         */
+        const vector<string> &get_values() const { return values; }
+
+        /**
+         * @brief Removes all the values.
+         */
+        void clear()
+        {
+            values.clear();
+            codes.clear();
+        }
+
+    private:
+        vector<string> values;
+        unordered_map<string, uint64_t, string_hash, equal_to<>> codes;
+    };
+
+    /**
+     * @brief Compression of an input file.
+     */
+    enum class compression
+    {
+        none,
+        gzip,
+        zstd
+    };
+
+    /**
+     * @brief Finds the compression of a file from its first bytes (the magic number of the format).
+     * @param file_name Name of the file.
+     */
+    inline compression detect_compression(const string &file_name)
+    {
+        unsigned char magic[4] = {0, 0, 0, 0};
+        ifstream input(file_name, ios::binary);
+        input.read((char *)magic, 4);
+        uint64_t n = (uint64_t)input.gcount();
+        if (n >= 2 and magic[0] == 0x1f and magic[1] == 0x8b)
+            return compression::gzip;
+        if (n == 4 and magic[0] == 0x28 and magic[1] == 0xb5 and magic[2] == 0x2f and magic[3] == 0xfd)
+            return compression::zstd;
+        return compression::none;
+    }
+
+    /**
+     * @brief Checks whether files with the given compression can be read by this build.
+     */
+    inline bool compression_supported(const compression &format)
+    {
+        switch (format)
+        {
+        case compression::none:
+            return true;
+        case compression::gzip:
+#ifdef READCSV_USE_ZLIB
+            return true;
+#else
+            return false;
+#endif
+        case compression::zstd:
+#ifdef READCSV_USE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        }
+        return false;
+    }
+
+    /**
+     * @brief Sequential reader of a file in large blocks.
+     * With a read-ahead depth above 0, a producer thread reads the next blocks of the file into a bounded
+     * queue of recycled buffers while the caller is still parsing the previous ones, so I/O and parsing overlap.
+     * With a depth of 0, the blocks are read by the caller when they are needed.
+     * A gzip or zstd file is decompressed while it is read (by the producer thread, if there is one),
+     * and the positions and characters are those of the decompressed text.
+     */
+    class block_reader
+    {
+    public:
+        /**
+         * @brief Size of a block read from the file at once.
+         */
+        static constexpr uint64_t block_size = 1 << 20;
+
+        /**
+         * @brief Opens the file and starts reading it ahead.
+         * @param file_name Name of the file to read.
+         * @param offset Position in the (decompressed) file to start reading from.
+         * @param depth Number of blocks read ahead (0 means no read-ahead thread).
+         */
+        block_reader(const string &, const uint64_t &, const uint64_t &);
+        ~block_reader();
+        block_reader(const block_reader &) = delete;
+        block_reader &operator=(const block_reader &) = delete;
+
+        /**
+         * @brief Checks whether the file could be opened.
+         */
+        bool is_open() const { return opened; }
+
+        /**
+         * @brief Checks whether reading the file failed (the data read before the failure is still given by read()).
+         * A compressed file that is corrupt or cut short also fails.
+         */
+        bool failed() const { return error; }
+
+        /**
+         * @brief Reads the next characters of the file.
+         * @param dest Where the characters are copied.
+         * @param n Number of characters to read.
+         * @return uint64_t Number of characters read, which is less than n only at the end of the file.
+         */
+        uint64_t read(char *, const uint64_t &);
+
+    private:
+        /**
+         * @brief Reads up to n characters from the file, stopping only at the end of the file or on a failure.
+         */
+        uint64_t read_file(char *, const uint64_t &);
+
+        /**
+         * @brief Reads up to n characters of the decompressed text, stopping only at the end of the file or on a failure.
+         */
+        uint64_t read_decoded(char *, const uint64_t &);
+
+        /**
+         * @brief The loop of the read-ahead thread: fills the free buffers and queues them in file order.
+         * A block of size 0 marks the end of the file.
+         */
+        void produce();
+
+        bool opened = false;
+        atomic<bool> error = false;
+        compression format = compression::none;
+        vector<char> raw;        // Compressed characters waiting to be decompressed
+        bool raw_done = false;   // The whole compressed file has been read
+        bool need_input = true;  // The decoder has given out everything it could from the input it has
+        bool frame_done = false; // The decoder is between two compressed streams (so the file may end here)
+#ifdef READCSV_USE_ZLIB
+        z_stream gz = {};
+        bool gz_started = false;
+#endif
+#ifdef READCSV_USE_ZSTD
+        ZSTD_DStream *zs = nullptr;
+        ZSTD_inBuffer zin = {nullptr, 0, 0};
+#endif
+#ifdef _WIN32
+        ifstream input;
+#else
+        int fd = -1;
+        uint64_t position = 0; // Position of the next read in the file
+#endif
+        vector<vector<char>> blocks;
+        vector<uint64_t> sizes;
+        deque<uint64_t> free_blocks;
+        deque<uint64_t> full_blocks;
+        mutex queue_lock;
+        condition_variable queue_changed;
+        bool stopping = false;
+        thread producer;
+        uint64_t current = UINT64_MAX; // The block being copied by read(), taken from full_blocks
+        uint64_t current_pos = 0;
+        bool finished = false;
+    };
+
+    inline block_reader::block_reader(const string &file_name, const uint64_t &offset, const uint64_t &depth)
+    {
+        format = detect_compression(file_name);
+#ifdef _WIN32
+        input.open(file_name, ios::binary);
+        if (!input.is_open())
+            return;
+#else
+        fd = open(file_name.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL); // Larger read-ahead by the kernel
+#endif
+#endif
+        opened = true;
+        if (format == compression::none)
+        {
+#ifdef _WIN32
+            input.seekg((streamoff)offset, ios::beg);
+#else
+            position = offset;
+#endif
+        }
+        else
+        {
+            raw.resize(block_size / 4);
+#ifdef READCSV_USE_ZLIB
+            // 16 + MAX_WBITS: a gzip header and trailer around the deflate stream
+            if (format == compression::gzip)
+                gz_started = (inflateInit2(&gz, 16 + MAX_WBITS) == Z_OK);
+#endif
+#ifdef READCSV_USE_ZSTD
+            if (format == compression::zstd)
+                zs = ZSTD_createDStream();
+#endif
+            // Decompressing and dropping the text before the offset
+            vector<char> skipped(min(offset, block_size));
+            uint64_t left = offset;
+            while (left > 0)
+            {
+                uint64_t n = read_decoded(skipped.data(), min<uint64_t>(left, skipped.size()));
+                if (n == 0)
+                    break;
+                left -= n;
+            }
+        }
+        if (depth > 0)
+        {
+            blocks.resize(depth);
+            sizes.resize(depth, 0);
+            for (uint64_t k = 0; k < depth; k++)
+            {
+                blocks[k].resize(block_size);
+                free_blocks.push_back(k);
+            }
+            producer = thread(&block_reader::produce, this);
+        }
+    }
+
+    inline block_reader::~block_reader()
+    {
+        if (producer.joinable())
+        {
+            {
+                lock_guard<mutex> guard(queue_lock);
+                stopping = true;
+            }
+            queue_changed.notify_all();
+            producer.join();
+        }
+#ifdef READCSV_USE_ZLIB
+        if (gz_started)
+            inflateEnd(&gz);
+#endif
+#ifdef READCSV_USE_ZSTD
+        if (zs != nullptr)
+            ZSTD_freeDStream(zs);
+#endif
+#ifndef _WIN32
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    inline uint64_t block_reader::read_file(char *dest, const uint64_t &n)
+    {
+        uint64_t total = 0;
+#ifdef _WIN32
+        input.read(dest, (streamsize)n);
+        total = (uint64_t)input.gcount();
+        if (input.bad())
+            error = true;
+#else
+        while (total < n)
+        {
+            ssize_t got = ::pread(fd, dest + total, n - total, (off_t)position);
+            if (got < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                error = true;
+                break;
+            }
+            if (got == 0)
+                break;
+            total += (uint64_t)got;
+            position += (uint64_t)got;
+        }
+#endif
+        return total;
+    }
+
+    inline uint64_t block_reader::read_decoded(char *dest, const uint64_t &n)
+    {
+        if (format == compression::none)
+            return read_file(dest, n);
+        uint64_t total = 0;
+        while (total < n and !error)
+        {
+            if (format == compression::gzip)
+            {
+#ifdef READCSV_USE_ZLIB
+                if (!gz_started)
+                {
+                    error = true;
+                    break;
+                }
+                if (gz.avail_in == 0 and need_input)
+                {
+                    uint64_t got = raw_done ? 0 : read_file(raw.data(), raw.size());
+                    if (got == 0)
+                    {
+                        raw_done = true;
+                        if (!frame_done)
+                            error = true; // The file was cut short
+                        break;
+                    }
+                    gz.next_in = (Bytef *)raw.data();
+                    gz.avail_in = (uInt)got;
+                }
+                gz.next_out = (Bytef *)(dest + total);
+                gz.avail_out = (uInt)min<uint64_t>(n - total, UINT32_MAX);
+                uInt before = gz.avail_out;
+                int status = inflate(&gz, Z_NO_FLUSH);
+                total += before - gz.avail_out;
+                need_input = (gz.avail_out > 0);
+                if (status == Z_STREAM_END)
+                {
+                    frame_done = true;
+                    inflateReset(&gz); // Concatenated gzip files are decompressed one after another
+                }
+                else if (status == Z_OK or status == Z_BUF_ERROR)
+                {
+                    if (before != gz.avail_out)
+                        frame_done = false;
+                }
+                else
+                {
+                    error = true;
+                }
+#else
+                error = true;
+#endif
+            }
+            else
+            {
+#ifdef READCSV_USE_ZSTD
+                if (zs == nullptr)
+                {
+                    error = true;
+                    break;
+                }
+                if (zin.pos == zin.size and need_input)
+                {
+                    uint64_t got = raw_done ? 0 : read_file(raw.data(), raw.size());
+                    if (got == 0)
+                    {
+                        raw_done = true;
+                        if (!frame_done)
+                            error = true; // The file was cut short
+                        break;
+                    }
+                    zin = {raw.data(), (size_t)got, 0};
+                }
+                ZSTD_outBuffer out = {dest + total, (size_t)(n - total), 0};
+                size_t status = ZSTD_decompressStream(zs, &out, &zin);
+                if (ZSTD_isError(status))
+                {
+                    error = true;
+                    break;
+                }
+                total += out.pos;
+                need_input = (out.pos < out.size);
+                frame_done = (status == 0); // Every frame of the file is decompressed in turn
+#else
+                error = true;
+#endif
+            }
+        }
+        return total;
+    }
+
+    inline void block_reader::produce()
+    {
+        while (true)
+        {
+            uint64_t k;
+            {
+                unique_lock<mutex> guard(queue_lock);
+                queue_changed.wait(guard, [this]
+                                   { return stopping or !free_blocks.empty(); });
+                if (stopping)
+                    return;
+                k = free_blocks.front();
+                free_blocks.pop_front();
+            }
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+            // Asking the kernel to start on the blocks after this one, so a slow device works while we copy
+            posix_fadvise(fd, (off_t)(position + block_size), (off_t)(blocks.size() * block_size), POSIX_FADV_WILLNEED);
+#endif
+            uint64_t size = read_decoded(blocks[k].data(), block_size);
+            {
+                lock_guard<mutex> guard(queue_lock);
+                sizes[k] = size;
+                full_blocks.push_back(k);
+            }
+            queue_changed.notify_all();
+            if (size == 0)
+                return;
+        }
+    }
+
+    inline uint64_t block_reader::read(char *dest, const uint64_t &n)
+    {
+        if (blocks.empty())
+            return read_decoded(dest, n);
+        uint64_t total = 0;
+        while (total < n and !finished)
+        {
+            if (current == UINT64_MAX)
+            {
+                unique_lock<mutex> guard(queue_lock);
+                queue_changed.wait(guard, [this]
+                                   { return !full_blocks.empty(); });
+                current = full_blocks.front();
+                full_blocks.pop_front();
+                current_pos = 0;
+                if (sizes[current] == 0)
+                {
+                    finished = true;
+                    break;
+                }
+            }
+            uint64_t count = min(n - total, sizes[current] - current_pos);
+            memcpy(dest + total, blocks[current].data() + current_pos, count);
+            total += count;
+            current_pos += count;
+            if (current_pos == sizes[current]) // Giving the buffer back to be filled again
+            {
+                {
+                    lock_guard<mutex> guard(queue_lock);
+                    free_blocks.push_back(current);
+                }
+                queue_changed.notify_all();
+                current = UINT64_MAX;
+            }
+        }
+        return total;
+    }
+
+    /**
+     * @brief Splits a file into lines, reading it through a block_reader into a buffer that is reused for every line.
+     */
+    class line_reader
+    {
+    public:
+        /**
+         * @brief Opens the file.
+         * @param file_name Name of the file to read.
+         * @param offset Position in the file of the first line.
+         * @param depth Number of blocks read ahead (see block_reader).
+         */
+        line_reader(const string &file_name, const uint64_t &offset, const uint64_t &depth)
+            : source(file_name, offset, depth), text(block_reader::block_size) {}
+
+        /**
+         * @brief Checks whether the file could be opened.
+         */
+        bool is_open() const { return source.is_open(); }
+
+        /**
+         * @brief Checks whether reading the file failed.
+         */
+        bool failed() const { return source.failed(); }
+
+        /**
+         * @brief Gets the next line, without its '\n' (a '\r' before it is kept).
+         * The view is valid until the next call.
+         * @return True if there was a line left; the last line does not have to end with a line break.
+         */
+        bool next(string_view &);
+
+        /**
+         * @brief Checks whether the last line given by next() ended with a line break
+         * (the last line of a file that is still being written may not be complete yet).
+         */
+        bool line_complete() const { return complete; }
+
+    private:
+        /**
+         * @brief Keeps the unread part of the buffer, and reads more of the file after it.
+         */
+        void refill();
+
+        block_reader source;
+        vector<char> text; // Grows only if a single line is longer than a block
+        uint64_t text_first = 0;
+        uint64_t text_last = 0;
+        bool input_done = false;
+        bool complete = false;
+    };
+
+    inline void line_reader::refill()
+    {
+        // Moving the partial line to the front of the buffer
+        memmove(text.data(), text.data() + text_first, text_last - text_first);
+        text_last -= text_first;
+        text_first = 0;
+        if (text_last == text.size())
+            text.resize(text.size() * 2); // The line does not fit in the buffer
+        uint64_t wanted = text.size() - text_last;
+        uint64_t n = source.read(text.data() + text_last, wanted);
+        if (n < wanted)
+            input_done = true;
+        text_last += n;
+    }
+
+    inline bool line_reader::next(string_view &line)
+    {
+        while (true)
+        {
+            const char *first = text.data() + text_first;
+            const char *end = (const char *)memchr(first, '\n', text_last - text_first);
+            complete = (end != nullptr);
+            if (end == nullptr)
+            {
+                if (!input_done)
+                {
+                    refill();
+                    continue;
+                }
+                if (text_first == text_last)
+                    return false;
+                end = text.data() + text_last; // The last line does not have to end with a line break
+            }
+            line = string_view(first, (size_t)(end - first));
+            text_first = min<uint64_t>((uint64_t)(end - text.data()) + 1, text_last);
+            return true;
+        }
+    }
+
+    /**
+     * @brief Finds the dialect of a csv file from its first lines (at most 100 lines, or 64 KB).
+     * The delimiter is the candidate (',', '\t', ';' or '|') found the same number of times on every line
+     * (the most often, if several are); fields are quoted with '"' if the sample has any,
+     * and trimmed if a delimiter has a space next to it.
+     * @param file_name Name of the file (compressed files are decompressed).
+     * @return csv_dialect The dialect (the default one if nothing fits).
+     */
+    inline csv_dialect sniff_dialect(const string &file_name)
+    {
+        line_reader input(file_name, 0, 0);
+        vector<string> lines;
+        uint64_t bytes = 0;
+        string_view line;
+        while (bytes < (1 << 16) and lines.size() < 100 and input.next(line))
+        {
+            bytes += line.size() + 1;
+            if (!line.empty() and line.back() == '\r')
+                line.remove_suffix(1);
+            if (!line.empty())
+                lines.push_back(string(line));
+        }
+
+        csv_dialect dialect;
+        for (const string &sample : lines)
+        {
+            if (sample.find('"') != string::npos)
+                dialect.quote = '"';
+        }
+        // Number of times a character is on a line, outside quotes
+        auto count = [&](const string &sample, const char &candidate)
+        {
+            uint64_t n = 0;
+            bool inside = false;
+            for (const char &c : sample)
+            {
+                if (c == dialect.quote and dialect.quote != '\0')
+                    inside = !inside;
+                else if (c == candidate and !inside)
+                    n++;
+            }
+            return n;
+        };
+        uint64_t best = 0;
+        for (const char &candidate : {',', '\t', ';', '|'})
+        {
+            uint64_t n = lines.empty() ? 0 : count(lines[0], candidate);
+            bool consistent = all_of(lines.begin(), lines.end(), [&](const string &sample)
+                                     { return count(sample, candidate) == n; });
+            if (consistent and n > best)
+            {
+                best = n;
+                dialect.delimiter = candidate;
+            }
+        }
+        for (const string &sample : lines)
+        {
+            for (uint64_t k = 0; k < sample.size(); k++)
+            {
+                if (sample[k] == dialect.delimiter and ((k > 0 and sample[k - 1] == ' ') or (k + 1 < sample.size() and sample[k + 1] == ' ')))
+                    dialect.trim = true;
+            }
+        }
+        return dialect;
+    }
+} // namespace csv_detail
+
+/**
+ * @brief Type of a column in a table.
+ */
+enum class column_type
+{
+    /**
+     * @brief Signed integers, stored as int64_t.
+     */
+    int64,
+    /**
+     * @brief Unsigned integers, stored as uint64_t.
+     */
+    uint64,
+    /**
+     * @brief Floating-point numbers, stored as double.
+     */
+    float64,
+    /**
+     * @brief Text, stored as codes into the string pool of the table (equal strings share a code).
+     */
+    string
+};
+
+/**
+ * @brief A data set with its own type for every column, given by csv::read_table().
+ * Every column is stored in its own contiguous buffer of its native type.
+ * The strings are interned: each distinct string is kept once in a single arena,
+ * and a string column holds 32-bit codes into it.
+ */
+class table
+{
+public:
+    table(table &&) = default;
+    table &operator=(table &&) = default;
+    table(const table &) = delete; // The string views point into this table's own arena
+    table &operator=(const table &) = delete;
+
+    /**
+     * @brief Gets the number of rows.
+     */
+    uint64_t get_rows() const { return rows; }
+
+    /**
+     * @brief Gets the number of columns.
+     */
+    uint64_t get_cols() const { return types.size(); }
+
+    /**
+     * @brief Gets the names of the columns.
+     */
+    const vector<string> &get_column_names() const { return names; }
+
+    /**
+     * @brief Gets the type of a column.
+     * @param col The column (starting from 0).
+     */
+    column_type get_type(const uint64_t &col) const { return types.at(col); }
+
+    /**
+     * @brief Gets a column of type column_type::int64.
+     * @param col The column (starting from 0).
+     */
+    span<const int64_t> int64_column(const uint64_t &col) const { return column_of<int64_t>(col); }
+
+    /**
+     * @brief Gets a column of type column_type::uint64.
+     * @param col The column (starting from 0).
+     */
+    span<const uint64_t> uint64_column(const uint64_t &col) const { return column_of<uint64_t>(col); }
+
+    /**
+     * @brief Gets a column of type column_type::float64.
+     * @param col The column (starting from 0).
+     */
+    span<const double> float64_column(const uint64_t &col) const { return column_of<double>(col); }
+
+    /**
+     * @brief Gets the string codes of a column of type column_type::string (see get_string()).
+     * @param col The column (starting from 0).
+     */
+    span<const uint32_t> string_codes(const uint64_t &col) const { return column_of<uint32_t>(col); }
+
+    /**
+     * @brief Gets the string with the given code.
+     * @param code A code from string_codes().
+     */
+    string_view get_string(const uint32_t &code) const { return strings.at(code); }
+
+    /**
+     * @brief Gets a string of a column of type column_type::string.
+     * @param row The row (starting from 0).
+     * @param col The column (starting from 0).
+     */
+    string_view string_at(const uint64_t &row, const uint64_t &col) const { return strings[string_codes(col)[row]]; }
+
+    /**
+     * @brief Gets the number of distinct strings in the table.
+     */
+    uint64_t get_NStrings() const { return strings.size(); }
+
+    /**
+     * @brief Exception to be thrown if a column is accessed as a type it does not have.
+     */
+    class wrong_type : public invalid_argument
+    {
+    public:
+        wrong_type() : invalid_argument("\nThe column does not have the requested type!\n\n"){};
+    };
+
+private:
+    template <typename, typename, typename>
+    friend class csv;
+
+    table(const vector<string> &_names, const vector<column_type> &_types) : names(_names), types(_types)
+    {
+        columns.reserve(types.size());
+        for (const column_type &type : types)
+        {
+            switch (type)
+            {
+            case column_type::int64:
+                columns.emplace_back(in_place_type<vector<int64_t>>);
+                break;
+            case column_type::uint64:
+                columns.emplace_back(in_place_type<vector<uint64_t>>);
+                break;
+            case column_type::float64:
+                columns.emplace_back(in_place_type<vector<double>>);
+                break;
+            case column_type::string:
+                columns.emplace_back(in_place_type<vector<uint32_t>>);
+                break;
+            }
+        }
+    }
+
+    template <typename V>
+    span<const V> column_of(const uint64_t &col) const
+    {
+        const vector<V> *values = get_if<vector<V>>(&columns.at(col));
+        if (values == nullptr)
+        {
+            throw wrong_type();
+        }
+        return span<const V>(*values);
+    }
+
+    /**
+     * @brief Reserves room for the given number of rows in every column.
+     */
+    void reserve(const uint64_t &n)
+    {
+        for (auto &column : columns)
+            visit([&](auto &values)
+                  { values.reserve(n); },
+                  column);
+    }
+
+    /**
+     * @brief Converts a field and appends it to its column.
+     * @param col The column (starting from 0).
+     * @param value The text of the field.
+     * @return False if the field is not a valid value of the type of the column.
+     */
+    bool append(const uint64_t &col, string_view value)
+    {
+        switch (types[col])
+        {
+        case column_type::int64:
+            return append_number<int64_t>(col, value);
+        case column_type::uint64:
+            return append_number<uint64_t>(col, value);
+        case column_type::float64:
+            return append_number<double>(col, value);
+        case column_type::string:
+            get<vector<uint32_t>>(columns[col]).push_back(intern(value));
+            return true;
+        }
+        return false;
+    }
+
+    template <typename V>
+    bool append_number(const uint64_t &col, string_view value)
+    {
+        V number;
+        if (!csv_detail::parse_number(value, number))
+        {
+            return false;
+        }
+        get<vector<V>>(columns[col]).push_back(number);
+        return true;
+    }
+
+    /**
+     * @brief Removes the values after the first n rows (those of a row that was only partly appended).
+     */
+    void truncate(const uint64_t &n)
+    {
+        for (auto &column : columns)
+            visit([&](auto &values)
+                  { values.resize(min<uint64_t>(values.size(), n)); },
+                  column);
+    }
+
+    /**
+     * @brief Appends the fill value to the columns with fewer than n rows (the cells of a row that could not be read).
+     * Integer columns get the largest value of their type if the fill value is NaN, and string columns an empty string.
+     */
+    void pad(const uint64_t &n, const double &fill_value)
+    {
+        for (auto &column : columns)
+            visit([&](auto &values)
+                  {
+                using V = typename remove_reference_t<decltype(values)>::value_type;
+                while (values.size() < n)
+                {
+                    if constexpr (is_same_v<V, uint32_t>)
+                        values.push_back(intern(""));
+                    else if constexpr (is_floating_point_v<V>)
+                        values.push_back((V)fill_value);
+                    else
+                        values.push_back(isnan(fill_value) ? numeric_limits<V>::max() : (V)fill_value);
+                } },
+                  column);
+    }
+
+    /**
+     * @brief Finds the code of a string, copying it into the arena the first time it is seen.
+     */
+    uint32_t intern(string_view value)
+    {
+        auto found = interned.find(value);
+        if (found != interned.end())
+        {
+            return found->second;
+        }
+        // The arena grows in chunks that never move, so the views of the strings stay valid
+        if (chunk_left < value.size())
+        {
+            uint64_t size = max<uint64_t>(value.size(), chunk_size);
+            arena.push_back(make_unique<char[]>(size));
+            chunk_next = arena.back().get();
+            chunk_left = size;
+        }
+        if (!value.empty())
+        {
+            memcpy(chunk_next, value.data(), value.size());
+        }
+        string_view stored(chunk_next, value.size());
+        chunk_next += value.size();
+        chunk_left -= value.size();
+        uint32_t code = (uint32_t)strings.size();
+        strings.push_back(stored);
+        interned.emplace(stored, code);
+        return code;
+    }
+
+    static constexpr uint64_t chunk_size = 1 << 16;
+
+    vector<string> names;
+    vector<column_type> types;
+    vector<variant<vector<int64_t>, vector<uint64_t>, vector<double>, vector<uint32_t>>> columns;
+    uint64_t rows = 0;
+    vector<unique_ptr<char[]>> arena;
+    char *chunk_next = nullptr;
+    uint64_t chunk_left = 0;
+    vector<string_view> strings;
+    unordered_map<string_view, uint32_t> interned;
+};
+
+/**
+ * @brief Class of csv
+ *  to read an input file in csv format.
+ * @tparam T type which is usually a double.
+ * @tparam Alloc allocator of the returned data sets (std::allocator by default).
+ * @tparam Observer receives the progress and the timings of every stage of loading (see null_observer).
+ */
+template <typename T, typename Alloc = allocator<T>, typename Observer = null_observer>
+class csv
+{
+public:
+    /**
+     * @brief Constructs a new csv object.
+     * Gets the metadata, such as number of rows, number of columns, and header names.
+     * In load_mode::mapped, the file is mapped and only the header is read here;
+     * the rows are counted while read_data() parses them.
+     * @param _file_name Name of the csv file to read.
+     * @param _options Loading options (see csv_options).
+     * @param _allocator The allocator of the returned data sets (for example, an aligned_allocator or a pmr arena).
+     * @param _observer The observer of the progress (a copy of it is kept).
+     */
+    csv(const string &, const csv_options & = csv_options(), const Alloc & = Alloc(), const Observer & = Observer());
+
+    /**
+     * @brief Gets the observer of the progress, for example to read the metrics it collected.
+     */
+    Observer &get_observer() { return observer; }
+
+    /**
+     * @brief Exception to be thrown if the file cannot be opened.
+     * @param file Name of the file (given in the message).
+     */
+    class file_notfound : public invalid_argument
+    {
+    public:
+        file_notfound(const string &file) : invalid_argument("\nFile \"" + file + "\": Cannot open a file with the given name!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if getting the file encounters an error.
+     */
+    class input_failed : public invalid_argument
+    {
+    public:
+        input_failed() : invalid_argument("\nEncountered an error in input!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if the file contains empty lines.
+     * @param line Number of the empty line (given in the message; the header is line 0).
+     */
+    class empty_line : public invalid_argument
+    {
+    public:
+        empty_line(const uint64_t &line) : invalid_argument("\nLine number " + to_string(line) + " is empty. Please remove the empty line and try again!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if the number of columns is less than expected.
+     */
+    class less_column : public out_of_range
+    {
+    public:
+        less_column() : out_of_range("\nExpected less columns!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if the number of columns is more than expected.
+     */
+    class more_column : public out_of_range
+    {
+    public:
+        more_column() : out_of_range("\nExpected more columns!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if the requested rows are not in the data set.
+     */
+    class row_invalid : public out_of_range
+    {
+    public:
+        row_invalid() : out_of_range("\nThe requested rows are not in the data set!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if a number value is not valid.
+     */
+    class number_invalid : public invalid_argument
+    {
+    public:
+        number_invalid() : invalid_argument("\nThe number is invalid and cannot be converted!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if the file is compressed with a format this build cannot read.
+     * @param file Name of the file (given in the message).
+     */
+    class compression_unsupported : public invalid_argument
+    {
+    public:
+        compression_unsupported(const string &file) : invalid_argument("\nFile \"" + file + "\": The file is compressed; build with READCSV_USE_ZLIB (gzip) or READCSV_USE_ZSTD (zstd) to read it!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if the dialect cannot be parsed (such as a line break or the quote as delimiter).
+     */
+    class dialect_invalid : public invalid_argument
+    {
+    public:
+        dialect_invalid() : invalid_argument("\nThe delimiter must be different from the quote and from line breaks!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if the schema given to read_table() does not have one type for every selected column.
+     */
+    class schema_invalid : public invalid_argument
+    {
+    public:
+        schema_invalid() : invalid_argument("\nThe schema must give exactly one type for every selected column!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if a selected column does not exist or is selected more than once.
+     * @param column The column (given in the message): its name in quotes, or its index.
+     */
+    class column_invalid : public invalid_argument
+    {
+    public:
+        column_invalid(const string &column) : invalid_argument("\nColumn " + column + ": The selected column does not exist or is selected more than once!\n\n"){};
+    };
+
+    /**
+     * @brief Reads the data set line by line,
+     * and returns the dataset in matrix format.
+     * In load_mode::mapped, this is the only pass over the file, and it also counts the rows.
+     * @param row_num if true, row numbers are added to the data set.
+     * @return matrix<double> The received dataset.
+     */
+    matrix<T, Alloc> read_data(bool const &);
+
+    /**
+     * @brief Reads the data set like read_data(), but returns it column by column:
+     * the values of each column are contiguous, and the parser writes them straight into this layout.
+     * The rows are counted before parsing (in load_mode::mapped, with a quick scan of the mapped file).
+     * @param row_num if true, row numbers are added to the data set (as its first column).
+     * @return column_matrix<T, Alloc> The received dataset.
+     */
+    column_matrix<T, Alloc> read_columns(bool const &);
+
+    /**
+     * @brief Reads the data set with its own type for every selected column, in a single pass over the file.
+     * Numeric columns are converted straight into their native type, and string columns are interned.
+     * For example: my_dataset.read_table({column_type::string, column_type::int64, column_type::float64})
+     * @param types The type of every selected column, in the order of the selection.
+     * @return table The received dataset.
+     */
+    table read_table(const vector<column_type> &);
+
+    /**
+     * @brief Reads only the given rows, seeking straight to them with the row index (see csv_options::index_step).
+     * If there is no index yet, the rows are counted once to build it (with a step of 1024 rows if none was given).
+     * @param first The first row to read (starting from 0).
+     * @param count Number of rows to read.
+     * @param row_num if true, row numbers are added to the rows.
+     * @return matrix<T, Alloc> The rows.
+     */
+    matrix<T, Alloc> get_rows(const uint64_t &, const uint64_t &, bool const &);
+
+    /**
+     * @brief Reads only the given row (see get_rows()).
+     * @param row The row to read (starting from 0).
+     * @param row_num if true, the row number is added to the row.
+     * @return matrix<T, Alloc> The row, as a matrix with one row.
+     */
+    matrix<T, Alloc> get_row(const uint64_t &, bool const &);
+
+    /**
+     * @brief Brings a data set up to date with a file that is being appended to, parsing only the new rows.
+     * The first call reads all the rows into data. Later calls check with a hash that the part of the file
+     * read before is unchanged, and append the rows added since then to data (and to the row numbers);
+     * if that part has changed, or data is not the matrix of the previous call, all the rows are read again.
+     * A last line without a line break may still be being written, so it is left for the next call.
+     * Compressed files are decompressed again from the start, but the rows read before are only checked (with a hash
+     * of the decompressed text), not parsed again. Files with encoded columns are read again once another member function has read the data.
+     * @param data The data set from the previous call (replaced on the first call).
+     * @param row_num if true, row numbers are added to the data set.
+     * @return uint64_t Number of rows added to data.
+     */
+    uint64_t refresh(matrix<T, Alloc> &, bool const &);
+
+    /**
+     * @brief Gets the number of columns that are read (all the columns of the file, unless some were selected).
+     * @return uint64_t NSelected.
+     */
+    uint64_t get_NCols() const;
+
+    /**
+     * @brief Gets the names of the columns that are read, in the order of the result.
+     * @return vector<string> The column names.
+     */
+    vector<string> get_column_names() const;
+
+    /**
+     * @brief Gets the number of rows.
+     * @return uint64_t NRows.
+     */
+    uint64_t get_NRows() const;
+
+    /**
+     * @brief Gets the header names, without copying them.
+     * @return const string & headers.
+     */
+    const string &get_header() const;
+
+    /**
+     * @brief Gets the row numbers, without copying them.
+     * The span stays valid until the data set is read again or the csv object is destroyed.
+     * @return span<const T> containing row numbers.
+     */
+    span<const T> get_row_numbers() const;
+
+    /**
+     * @brief Gets the dictionary of a column listed in csv_options::encode_columns: the value of every code
+     * found in that column of the last data set read (empty for the columns that are not encoded).
+     * @param col The column in the selection (starting from 0, without the row numbers).
+     * @return const vector<string>& The values, indexed by their codes.
+     */
+    const vector<string> &get_dictionary(const uint64_t &) const;
+
+    /**
+     * @brief Gets the dialect the file is read with (found by the constructor if csv_options::sniff is true).
+     * @return const csv_dialect& The dialect.
+     */
+    const csv_dialect &get_dialect() const;
+
+    /**
+     * @brief Gets the error log: the rows that could not be read by the last member function that read rows,
+     * in the order of the file (always empty in error_mode::strict). It keeps csv_options::max_errors entries at most.
+     * @return const vector<parse_error>& The errors.
+     */
+    const vector<parse_error> &get_errors() const;
+
+    /**
+     * @brief Gets the number of rows that could not be read by the last member function that read rows
+     * (including the ones that are not in the error log).
+     * @return uint64_t Number of errors.
+     */
+    uint64_t get_NErrors() const;
+
+    /**
+     * @brief A view of a batch of consecutive rows, given by batches().
+     * It stays valid until the next batch is read.
+     */
+    class row_batch
+    {
+    public:
+        /**
+         * @brief Gets the number of rows in the batch.
+         */
+        uint64_t get_rows() const { return rows; }
+
+        /**
+         * @brief Gets the number of columns (including the row numbers, if they were requested).
+         */
+        uint64_t get_cols() const { return cols; }
+
+        /**
+         * @brief Gets the index of the first row of the batch in the data set (starting from 0).
+         */
+        uint64_t get_first_row() const { return first_row; }
+
+        /**
+         * @brief Accesses an element of the batch WITHOUT range checking.
+         * @param row The row in the batch (starting from 0).
+         * @param col The column (starting from 0).
+         */
+        const T &operator()(const uint64_t &row, const uint64_t &col) const { return elements[(cols * row) + col]; }
+
+        /**
+         * @brief Gets a row of the batch.
+         * @param row The row in the batch (starting from 0).
+         */
+        span<const T> row(const uint64_t &row) const { return span<const T>(elements + (cols * row), cols); }
+
+        /**
+         * @brief Gets all the elements of the batch in row-major order.
+         */
+        span<const T> data() const { return span<const T>(elements, rows * cols); }
+
+    private:
+        friend class csv;
+        const T *elements = nullptr;
+        uint64_t rows = 0;
+        uint64_t cols = 0;
+        uint64_t first_row = 0;
+    };
+
+    /**
+     * @brief An input range of row batches, given by batches().
+     * The file is read through a bounded buffer, which is reused for every batch,
+     * so the memory needed does not depend on the size of the file.
+     * It must not outlive the csv object that created it.
+     */
+    class batch_range
+    {
+    public:
+        /**
+         * @brief Iterator over the batches; each increment reads the next batch.
+         */
+        class iterator
+        {
+        public:
+            using value_type = row_batch;
+            using difference_type = ptrdiff_t;
+
+            iterator() = default;
+            const row_batch &operator*() const { return range->current; }
+            const row_batch *operator->() const { return &range->current; }
+            iterator &operator++()
+            {
+                if (!range->next())
+                    range = nullptr;
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            bool operator==(default_sentinel_t) const { return range == nullptr; }
+
+        private:
+            friend class batch_range;
+            explicit iterator(batch_range *_range) : range(_range) {}
+            batch_range *range = nullptr;
+        };
+
+        /**
+         * @brief Reads the first batch. The range can be iterated only once.
+         */
+        iterator begin();
+
+        /**
+         * @brief The end of the range, reached after the last batch.
+         */
+        default_sentinel_t end() const { return default_sentinel; }
+
+    private:
+        friend class csv;
+        batch_range(csv *, const uint64_t &, bool const &);
+
+        /**
+         * @brief Reads the next batch into the reused buffer.
+         * @return True if at least one row was read.
+         */
+        bool next();
+
+        csv *source;
+        uint64_t batch_rows;
+        bool row_num;
+        uint64_t width;
+        csv_detail::line_reader input;
+        uint64_t bytes = 0;
+        uint64_t next_row = 0;
+        uint64_t next_line = 0; // Lines read, which differ from the rows when rows are left out
+        vector<T> values;
+        row_batch current;
+    };
+
+    /**
+     * @brief Reads the data set in batches of rows, keeping the memory bounded no matter how big the file is.
+     * For example: for (const auto &batch : my_dataset.batches(4096, false)) { ... }
+     * @param batch_rows Maximum number of rows in a batch.
+     * @param row_num if true, row numbers are added to the data set.
+     * @return batch_range A range of row_batch views.
+     */
+    batch_range batches(uint64_t const &, bool const &);
+
+private:
+    /**
+     * @brief Checks whether it is a valid number and converts it to T in the same pass.
+     * Integer types are read exactly with from_chars (no detour through double; a decimal point followed only by zeros is allowed),
+     * and floating-point types are read in fixed notation (an optional minus sign, digits and one decimal point).
+     * Other types are converted from a double.
+     * Spaces around the number are ignored.
+     * @param value_st The string of the value.
+     * @param value Where the converted number is written.
+     * @return True if it is valid.
+     * @return False invalid.
+     */
+    bool read_num(string_view, T &);
+
+    /**
+     * @brief Reads a row of the dataset in csv format.
+     * (columns are separated by comma).
+     * The fields are viewed in place and converted straight into the destination, without any allocation.
+     * Problems are returned instead of thrown, so that each row is checked once (see keep_row());
+     * in error_mode::fill, the cells that cannot be read are already filled.
+     * @param line The row of the data set (without the line ending).
+     * Only the selected columns are converted, and they are written in the order of the selection.
+     * @param row Where the first of the NSelected values of the row is written.
+     * @param stride Distance between the values of consecutive columns in the destination
+     * (1 for a row-major result, NRows for a column-major one).
+     * @param local_dictionaries Dictionaries for the encoded columns (the dictionaries of the object if nullptr).
+     * @return csv_detail::row_status The first problem of the row, if any.
+     */
+    csv_detail::row_status read_rows(string_view, T *, const uint64_t & = 1, vector<csv_detail::dictionary> * = nullptr);
+
+    /**
+     * @brief Splits a row of the dataset in csv format, and calls field(slot, value) for every selected column.
+     * @param line The row of the data set (without the line ending).
+     * @param field The function called with the position of the column in the selection and the text of the field;
+     * it returns false if the value is not valid.
+     * @return csv_detail::row_status The first problem of the row, if any.
+     */
+    template <typename F>
+    csv_detail::row_status split_row(string_view, const F &);
+
+    /**
+     * @brief Decides what happens to a row that could not be read, as set by csv_options::errors.
+     * In strict mode, it throws the exception of the problem; otherwise, the problem is recorded.
+     * @param status The problem of the row.
+     * @param row The row (starting from 1).
+     * @param offset Where the row starts in the file.
+     * @param log The error log the problem is added to (up to csv_options::max_errors entries).
+     * @param count The number of problems, including the ones not kept in the log.
+     * @return True if the row is kept (filled), false if it is left out.
+     */
+    bool keep_row(const csv_detail::row_status &, const uint64_t &, const uint64_t &, vector<parse_error> &, uint64_t &) const;
+
+    /**
+     * @brief Removes the room left by the rows that were left out, once the kept rows are at the beginning.
+     * @param elements The elements, with room for capacity rows (the columns are capacity apart if column-major).
+     * @param rows Number of rows kept.
+     * @param capacity Number of rows there is room for (NLines, unless the result grew while it was parsed).
+     * @param width Number of columns of the result.
+     * @param column_major Whether the result is column-major.
+     */
+    void compact(vector<T, Alloc> &, const uint64_t &, const uint64_t &, const uint64_t &, bool const &) const;
+
+    /**
+     * @brief Starts the timing of a stage, and reports it to the observer.
+     * @param stage The stage that begins.
+     */
+    void stage_begin(const load_stage &);
+
+    /**
+     * @brief Reports the progress of the current stage to the observer.
+     * @param bytes Bytes handled so far in the stage.
+     * @param rows Rows handled so far in the stage.
+     */
+    void stage_progress(const uint64_t &, const uint64_t &);
+
+    /**
+     * @brief Reports the end of the current stage to the observer.
+     * @param bytes Bytes handled in the stage.
+     * @param rows Rows handled in the stage.
+     */
+    void stage_end(const uint64_t &, const uint64_t &);
+
+    /**
+     * @brief Counts the columns of the header line and saves it.
+     * It also finds the selected columns (csv_options::columns and csv_options::column_indices).
+     * @param header_line The first line of the file (without the line ending).
+     */
+    void read_header(string_view);
+
+    /**
+     * @brief Finds the columns selected by csv_options::columns and csv_options::column_indices.
+     */
+    void select_columns();
+
+    /**
+     * @brief Counts the rows, stopping on the empty lines,
+     * and records the position of every options.index_step-th row (if it is above 0).
+     */
+    void count_rows();
+
+    /**
+     * @brief Loads the row index file, if it matches the csv file.
+     * @return True if it was loaded; NRows and row_offsets are updated.
+     */
+    bool load_index();
+
+    /**
+     * @brief Saves the row index next to the csv file (a failure only means it is not saved).
+     */
+    void save_index() const;
+
+    /**
+     * @brief Chooses how to read the data set, depending on the options and the layout.
+     * @param row_num if true, row numbers are added to the data set.
+     * @param column_major if true, the values are stored column by column.
+     * @return vector<T, Alloc> The elements of the data set; NRows is updated.
+     */
+    vector<T, Alloc> parse(bool const &, bool const &);
+
+    /**
+     * @brief Reads the data set again through a stream, with the rows counted by the constructor.
+     * @param row_num if true, row numbers are added to the data set.
+     * @param column_major if true, the values are stored column by column.
+     * @return vector<T, Alloc> The elements of the data set.
+     */
+    vector<T, Alloc> parse_stream(bool const &, bool const &);
+
+    /**
+     * @brief Reads the data set from the mapped file in a single pass,
+     * finding the rows and parsing them at the same time.
+     * @param row_num if true, row numbers are added to the data set.
+     * @return vector<T, Alloc> The elements of the data set in row-major order; NRows is updated.
+     */
+    vector<T, Alloc> parse_mapped(bool const &);
+
+    /**
+     * @brief Reads the data set from a compressed file in a single pass, decompressing it while the rows
+     * are found and parsed; the result grows as the rows come in (doubling its room for rows, and moving the columns
+     * apart if it is column-major), so the values are written straight into their final layout.
+     * @param row_num if true, row numbers are added to the data set.
+     * @param column_major if true, the elements are returned in column-major order.
+     * @return vector<T, Alloc> The elements of the data set; NRows is updated.
+     */
+    vector<T, Alloc> parse_compressed(bool const &, bool const &);
+
+    /**
+     * @brief Reads the data set from a mapped file on several threads.
+     * The rows are split into chunks of whole lines, the chunks are counted in parallel,
+     * and then each chunk is parsed straight into its own part of the result.
+     * @param row_num if true, row numbers are added to the data set.
+     * @param column_major if true, the values are stored column by column.
+     * @param file The mapped csv file.
+     * @param NThreads Number of threads.
+     * @return vector<T, Alloc> The elements of the data set; NRows is updated.
+     */
+    vector<T, Alloc> parse_parallel(bool const &, bool const &, const csv_detail::mapped_file &, const uint64_t &);
+
+    /**
+     * @brief Gets the name of the cache file.
+     */
+    string cache_name() const;
+
+    /**
+     * @brief Fills the parts of a cache header that describe the csv file and the options.
+     * @param header The cache header to fill.
+     * @return False if the csv file cannot be read.
+     */
+    bool describe_cache(csv_detail::cache_header &) const;
+
+    /**
+     * @brief Checks whether the cache file belongs to the current csv file and options.
+     * @param header The header read from the cache file.
+     * @return True if the cache can be used.
+     */
+    bool cache_valid(const csv_detail::cache_header &) const;
+
+    /**
+     * @brief Loads the data set from a valid cache file, if there is one, reporting the progress every 65536 rows.
+     * @param row_num if true, row numbers are added to the data set.
+     * @param column_major if true, the values are stored column by column.
+     * @param elements Where the elements of the data set are written; NRows is updated.
+     * @return False if there is no valid cache file.
+     */
+    bool load_cache(bool const &, bool const &, vector<T, Alloc> &);
+
+    /**
+     * @brief Saves the parsed data set in the cache file (errors are ignored, as the cache is only an optimization),
+     * reporting the progress every 65536 rows.
+     * @param row_num if true, the elements include row numbers.
+     * @param column_major if true, the elements are stored column by column.
+     * @param elements The elements of the data set.
+     */
+    void save_cache(bool const &, bool const &, const vector<T, Alloc> &);
+
+    /**
+     * @brief The name of the csv file.
+     */
+    string datafile;
+    /**
+     * @brief The loading options.
+     */
+    csv_options options;
+    /**
+     * @brief The allocator of the returned data sets.
+     */
+    Alloc allocator;
+    /**
+     * @brief The observer of the progress, and the stage being reported to it.
+     */
+    Observer observer;
+    load_progress progress;
+    chrono::steady_clock::time_point stage_start;
+    /**
+     * @brief Whether there is an observer at all; without one, the reports are not even prepared.
+     */
+    static constexpr bool observed = !is_same_v<Observer, null_observer>;
+    /**
+     * @brief The progress is reported once every (progress_mask + 1) rows.
+     */
+    static constexpr uint64_t progress_mask = (1 << 16) - 1;
+    /**
+     * @brief The mapped file (only in load_mode::mapped).
+     */
+    shared_ptr<const csv_detail::mapped_file> mapping;
+    /**
+     * @brief Compression of the file (found from its first bytes).
+     */
+    csv_detail::compression compressed = csv_detail::compression::none;
+    /**
+     * @brief Number of columns.
+     */
+    uint64_t NCols = 0;
+    /**
+     * @brief Number of columns that are read.
+     */
+    uint64_t NSelected = 0;
+    /**
+     * @brief Names of the columns in the file.
+     */
+    vector<string> column_names;
+    /**
+     * @brief For each column of the file, its position in a row of the result (UINT64_MAX if it is skipped).
+     */
+    vector<uint64_t> column_slot;
+    /**
+     * @brief Positions in the file of the rows 0, index_step, 2 * index_step, ... (empty if there is no index).
+     */
+    vector<uint64_t> row_offsets;
+    /**
+     * @brief Where refresh() stopped: the position after the last row read, the number of rows,
+     * and the hash of the file up to that position (tail_offset is 0 before the first call).
+     */
+    uint64_t tail_offset = 0;
+    uint64_t tail_rows = 0;
+    uint64_t tail_lines = 0;
+    uint64_t tail_hash = 0;
+    vector<uint64_t> tail_codes; // Sizes of the dictionaries, which other member functions build again
+
+    /**
+     * @brief Gets the number of values of each dictionary.
+     */
+    vector<uint64_t> dictionary_sizes() const;
+    /**
+     * @brief For each selected column, whether it is dictionary-encoded.
+     */
+    vector<bool> encoded;
+    /**
+     * @brief For each selected column, the dictionary of its values (empty if it is not encoded).
+     */
+    vector<csv_detail::dictionary> dictionaries;
+    /**
+     * @brief Header (column names, which is the first line).
+     */
+    string headers;
+    /**
+     * @brief Number of rows.
+     */
+    uint64_t NRows = 0;
+    /**
+     * @brief Number of lines of data in the file, which is NRows unless rows were left out (error_mode::skip_row).
+     */
+    uint64_t NLines = 0;
+    /**
+     * @brief Length of the header line, including its line ending.
+     */
+    uint64_t NChar = 0;
+    /**
+     * @brief A vector to save the row numbers.
+     */
+    vector<T> Row_numbers;
+    /**
+     * @brief The error log, and the number of errors (see get_errors()).
+     */
+    vector<parse_error> errors;
+    uint64_t NErrors = 0;
+    /**
+     * @brief csv_options::fill_value converted to T.
+     */
+    T filler = T();
+};
+
+// ==============
+// Implementation
+// ==============
+
+template <typename T, typename Alloc, typename Observer>
+csv<T, Alloc, Observer>::csv(const string &_file_name, const csv_options &_options, const Alloc &_allocator, const Observer &_observer)
+    : datafile(_file_name), options(_options), allocator(_allocator), observer(_observer)
+{
+    stage_begin(load_stage::open);
+    compressed = csv_detail::detect_compression(datafile);
+    if (compressed != csv_detail::compression::none)
+    {
+        if (!csv_detail::compression_supported(compressed))
+        {
+            throw typename csv::compression_unsupported(datafile);
+        }
+        // A compressed file can be neither mapped nor counted without decompressing it all,
+        // so only the header is read here, and the rows are counted while parsing in read_data()
+        csv_detail::line_reader input(datafile, 0, 0);
+        if (!input.is_open())
+        {
+            throw typename csv::file_notfound(datafile);
+        }
+        string_view line;
+        input.next(line);
+        if (input.failed())
+        {
+            throw typename csv::input_failed();
+        }
+        NChar = line.size() + 1; // Position of the first row in the decompressed text
+        if (!line.empty() and line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        read_header(line);
+        stage_end(NChar, 0);
+        return;
+    }
+    if (options.mode == load_mode::mapped)
+    {
+        mapping = make_shared<const csv_detail::mapped_file>(datafile);
+        if (!mapping->is_open())
+        {
+            throw typename csv::file_notfound(datafile);
+        }
+        // Only the header is read here; the rows are found while parsing in read_data()
+        string_view contents(mapping->data(), mapping->size());
+        uint64_t end = contents.find('\n');
+        if (end == string_view::npos)
+        {
+            end = contents.size();
+            NChar = contents.size();
+        }
+        else
+        {
+            NChar = end + 1;
+        }
+        read_header(contents.substr(0, end));
+        stage_end(NChar, 0);
+        return;
+    }
+
+    // Reading the data
+    ifstream input(datafile);
+    if (!input.is_open())
+    {
+        throw typename csv::file_notfound(datafile);
+    }
+    // Finding number of the columns and saving the headers
+    string line;
+    getline(input, line);
+    // Number of the characters in line 1 (headers), including "\n" or "\r\n"
+    NChar = input.eof() ? line.size() : (uint64_t)input.tellg();
+    read_header(line);
+
+    // With a valid cache, the number of rows is already known
+    if (options.cache == true)
+    {
+        csv_detail::cache_header cached;
+        ifstream cache(cache_name(), ios::binary);
+        if (cache.read((char *)&cached, sizeof(cached)) and cache_valid(cached))
+        {
+            NRows = cached.NRows;
+            NLines = NRows;
+            stage_end(NChar, NRows);
+            return;
+        }
+    }
+
+    // With a saved row index, the rows are not counted again
+    if (options.index_file == true and options.index_step > 0 and load_index())
+    {
+        stage_end(NChar, NRows);
+        return;
+    }
+    count_rows();
+}
+
+template <typename T, typename Alloc, typename Observer>
+void csv<T, Alloc, Observer>::count_rows()
+{
+    // Finding the number of rows
+    // The first row was the headers (column names), so we make sure to read the data from the second row
+    csv_detail::block_reader blocks(datafile, NChar, options.prefetch);
+    if (!blocks.is_open())
+    {
+        throw typename csv::file_notfound(datafile);
+    }
+    // The file is read in large blocks, which are scanned 64 characters at a time for the line breaks.
+    // The buffer has room for one more block, which stays zero, so the last block can be scanned whole.
+    const uint64_t buffer_size = csv_detail::block_reader::block_size;
+    vector<char> buffer(buffer_size + 64, 0);
+    uint64_t offset = 0;     // Position of the buffer in the data
+    uint64_t line_start = 0; // Position of the first character of the current line
+    char previous = 0;       // The character before the buffer
+    NRows = 0;
+    row_offsets.clear();
+    if (options.index_step > 0)
+    {
+        row_offsets.push_back(NChar); // Where the first row starts in the file
+    }
+    uint64_t n;
+    while ((n = blocks.read(buffer.data(), buffer_size)) > 0)
+    {
+        fill(buffer.begin() + (int64_t)n, buffer.begin() + (int64_t)n + 64, (char)0);
+        for (uint64_t block = 0; block < n; block += 64)
+        {
+            uint64_t newlines = csv_detail::scan_block(buffer.data() + block, options.dialect.delimiter).newlines;
+            while (newlines != 0)
+            {
+                uint64_t position = block + (uint64_t)countr_zero(newlines);
+                newlines &= newlines - 1;
+                uint64_t length = offset + position - line_start;
+                char before = (position > 0) ? buffer[position - 1] : previous;
+                // Stopping on the empty lines (in the other modes, they are handled while parsing)
+                if ((length == 0 or (length == 1 and before == '\r')) and options.errors == error_mode::strict) // Only the line ending is left in an empty line
+                {
+                    throw typename csv::empty_line(NRows + 1);
+                }
+                NRows++;
+                line_start = offset + position + 1;
+                if (options.index_step > 0 and NRows % options.index_step == 0)
+                {
+                    row_offsets.push_back(NChar + line_start);
+                }
+            }
+        }
+        previous = buffer[n - 1];
+        offset += n;
+        stage_progress(NChar + offset, NRows);
+    }
+    // The last line does not have to end with a line break
+    if (line_start < offset)
+    {
+        if (offset - line_start == 1 and previous == '\r' and options.errors == error_mode::strict)
+        {
+            throw typename csv::empty_line(NRows + 1);
+        }
+        NRows++;
+    }
+    if (blocks.failed())
+    {
+        throw typename csv::input_failed();
+    }
+    NLines = NRows;
+    stage_end(NChar + offset, NRows);
+    if (options.index_file == true and options.index_step > 0)
+    {
+        save_index();
+    }
+}
+
+template <typename T, typename Alloc, typename Observer>
+void csv<T, Alloc, Observer>::read_header(string_view header_line)
+{
+    if (!header_line.empty() and header_line.back() == '\r')
+    {
+        header_line.remove_suffix(1);
+    }
+    if (options.sniff == true)
+    {
+        options.dialect = csv_detail::sniff_dialect(datafile);
+    }
+    const csv_dialect &dialect = options.dialect;
+    if (dialect.delimiter == '\n' or dialect.delimiter == '\r' or dialect.delimiter == '\0' or dialect.delimiter == dialect.quote or
+        dialect.quote == '\n' or dialect.quote == '\r')
+    {
+        throw typename csv::dialect_invalid();
+    }
+    headers = string(header_line);
+    csv_detail::for_each_field(header_line, dialect, [&](string_view column)
+                               {
+        NCols++; // Updating the number of columns
+        column_names.push_back(string(column)); });
+
+    // Finding the selected columns
+    if (options.columns.empty() and options.column_indices.empty())
+    {
+        NSelected = NCols;
+        column_slot.resize(NCols);
+        for (uint64_t j = 0; j < NCols; j++)
+        {
+            column_slot[j] = j;
+        }
+    }
+    else
+    {
+        select_columns();
+    }
+
+    // Finding the encoded columns among the selected ones
+    dictionaries.assign(NSelected, csv_detail::dictionary());
+    if (!options.encode_columns.empty())
+    {
+        encoded.assign(NSelected, false);
+        for (const string &name : options.encode_columns)
+        {
+            uint64_t j = (uint64_t)(find(column_names.begin(), column_names.end(), name) - column_names.begin());
+            if (j == NCols or column_slot[j] == UINT64_MAX)
+            {
+                throw typename csv::column_invalid("\"" + name + "\"");
+            }
+            encoded[column_slot[j]] = true;
+        }
+        options.cache = false; // The dictionaries are not kept in the cache
+    }
+
+    if (options.errors != error_mode::strict)
+    {
+        options.cache = false; // Neither are the rows left out or filled
+    }
+    if constexpr (numeric_limits<T>::has_quiet_NaN)
+    {
+        filler = (T)options.fill_value;
+    }
+    else
+    {
+        filler = isnan(options.fill_value) ? numeric_limits<T>::max() : (T)options.fill_value;
+    }
+}
+
+template <typename T, typename Alloc, typename Observer>
+void csv<T, Alloc, Observer>::select_columns()
+{
+    vector<uint64_t> selection;
+    for (const string &name : options.columns)
+    {
+        uint64_t j = (uint64_t)(find(column_names.begin(), column_names.end(), name) - column_names.begin());
+        if (j == NCols)
+        {
+            throw typename csv::column_invalid("\"" + name + "\"");
+        }
+        selection.push_back(j);
+    }
+    selection.insert(selection.end(), options.column_indices.begin(), options.column_indices.end());
+    column_slot.assign(NCols, UINT64_MAX);
+    for (uint64_t k = 0; k < selection.size(); k++)
+    {
+        if (selection[k] >= NCols or column_slot[selection[k]] != UINT64_MAX)
+        {
+            throw typename csv::column_invalid(to_string(selection[k]));
+        }
+        column_slot[selection[k]] = k;
+    }
+    NSelected = selection.size();
+}
+
+template <typename T, typename Alloc, typename Observer>
+bool csv<T, Alloc, Observer>::read_num(string_view value_st, T &value)
+{
+    if constexpr ((is_integral_v<T> and !is_same_v<T, bool>) or is_floating_point_v<T>)
+    {
+        return csv_detail::parse_number(value_st, value);
+    }
+    else
+    {
+        // Other types are converted from a double
+        double number = 0;
+        if (!csv_detail::parse_number(value_st, number))
+        {
+            return false;
+        }
+        value = (T)number;
+        return true;
+    }
+}
+
+template <typename T, typename Alloc, typename Observer>
+csv_detail::row_status csv<T, Alloc, Observer>::read_rows(string_view line, T *row, const uint64_t &stride, vector<csv_detail::dictionary> *local_dictionaries)
+{
+    vector<csv_detail::dictionary> &codes = (local_dictionaries == nullptr) ? dictionaries : *local_dictionaries;
+    bool fill = (options.errors == error_mode::fill);
+    // Checking whether it is a number, and converting it in place
+    csv_detail::row_status status = split_row(line, [&](const uint64_t &slot, string_view value)
+                                              {
+        if (!encoded.empty() and encoded[slot])
+        {
+            row[slot * stride] = (T)codes[slot].encode(value);
+            return true;
+        }
+        if (read_num(value, row[slot * stride]))
+        {
+            return true;
+        }
+        if (fill)
+        {
+            row[slot * stride] = filler;
+        }
+        return false; });
+    // The missing columns of a short row are filled as well
+    if (!status.valid and fill)
+    {
+        for (uint64_t j = status.fields; j < NCols; j++)
+        {
+            if (column_slot[j] != UINT64_MAX)
+            {
+                row[column_slot[j] * stride] = filler;
+            }
+        }
+    }
+    return status;
+}
+
+template <typename T, typename Alloc, typename Observer>
+template <typename F>
+csv_detail::row_status csv<T, Alloc, Observer>::split_row(string_view line, const F &field)
+{
+    csv_detail::row_status status;
+    if (line.empty())
+    {
+        status.valid = false;
+        status.kind = error_kind::empty_line;
+        return status;
+    }
+    uint64_t j = 0; // Number of columns read for each row
+
+    // Extracting the value of a column from the row (with the parser of the dialect)
+    csv_detail::for_each_field(line, options.dialect, [&](string_view value)
+                               {
+        if (j >= NCols) // The values after the limit are not read
+        {
+            if (status.valid)
+            {
+                status.valid = false;
+                status.kind = error_kind::less_column;
+            }
+            j++;
+            return;
+        }
+        // The columns that are not selected are skipped
+        uint64_t slot = column_slot[j];
+        if (slot != UINT64_MAX and !field(slot, value) and status.valid)
+        {
+            status.valid = false;
+            status.kind = error_kind::number_invalid;
+            status.column = j;
+        }
+        j++; }); // Updating the size
+    status.fields = min(j, NCols);
+    // Checking whether the the number of read values is correct (equals the number of columns)
+    if (j < NCols and status.valid)
+    {
+        status.valid = false;
+        status.kind = error_kind::more_column;
+    }
+    return status;
+}
+
+template <typename T, typename Alloc, typename Observer>
+bool csv<T, Alloc, Observer>::keep_row(const csv_detail::row_status &status, const uint64_t &row, const uint64_t &offset, vector<parse_error> &log, uint64_t &count) const
+{
+    if (options.errors == error_mode::strict)
+    {
+        switch (status.kind)
+        {
+        case error_kind::empty_line:
+            throw typename csv::empty_line(row);
+        case error_kind::less_column:
+            throw typename csv::less_column();
+        case error_kind::more_column:
+            throw typename csv::more_column();
+        case error_kind::number_invalid:
+            throw typename csv::number_invalid();
+        }
+    }
+    count++;
+    if (log.size() < options.max_errors)
+    {
+        log.push_back(parse_error{row, status.column, offset, status.kind});
+    }
+    return options.errors == error_mode::fill;
+}
+
+template <typename T, typename Alloc, typename Observer>
+void csv<T, Alloc, Observer>::compact(vector<T, Alloc> &elements, const uint64_t &rows, const uint64_t &capacity, const uint64_t &width, bool const &column_major) const
+{
+    if (column_major == true and rows < capacity)
+    {
+        for (uint64_t j = 1; j < width; j++)
+        {
+            copy(elements.begin() + (int64_t)(j * capacity), elements.begin() + (int64_t)(j * capacity + rows), elements.begin() + (int64_t)(j * rows));
+        }
+    }
+    elements.resize(rows * width);
+}
+
+template <typename T, typename Alloc, typename Observer>
+matrix<T, Alloc> csv<T, Alloc, Observer>::read_data(bool const &row_num)
+{
+    vector<T, Alloc> elements = parse(row_num, false);
+    // The matrix takes over the parsed elements without copying them
+    return matrix<T, Alloc>(NRows, (row_num == true) ? NSelected + 1 : NSelected, move(elements));
+}
+
+template <typename T, typename Alloc, typename Observer>
+column_matrix<T, Alloc> csv<T, Alloc, Observer>::read_columns(bool const &row_num)
+{
+    vector<T, Alloc> elements = parse(row_num, true);
+    return column_matrix<T, Alloc>(NRows, (row_num == true) ? NSelected + 1 : NSelected, move(elements));
+}
+
+template <typename T, typename Alloc, typename Observer>
+void csv<T, Alloc, Observer>::stage_begin(const load_stage &stage)
+{
+    if constexpr (observed)
+    {
+        progress = load_progress();
+        progress.stage = stage;
+        if (stage == load_stage::parse and compressed == csv_detail::compression::none)
+        {
+            error_code error;
+            uint64_t size = (uint64_t)filesystem::file_size(datafile, error);
+            progress.total_bytes = (!error and size > NChar) ? size - NChar : 0;
+        }
+        stage_start = chrono::steady_clock::now();
+        observer.stage_begin(stage);
+    }
+}
+
+template <typename T, typename Alloc, typename Observer>
+void csv<T, Alloc, Observer>::stage_progress(const uint64_t &bytes, const uint64_t &rows)
+{
+    if constexpr (observed)
+    {
+        progress.bytes = bytes;
+        progress.rows = rows;
+        progress.seconds = chrono::duration<double>(chrono::steady_clock::now() - stage_start).count();
+        observer.stage_progress(progress);
+    }
+}
+
+template <typename T, typename Alloc, typename Observer>
+void csv<T, Alloc, Observer>::stage_end(const uint64_t &bytes, const uint64_t &rows)
+{
+    if constexpr (observed)
+    {
+        progress.bytes = bytes;
+        progress.rows = rows;
+        progress.seconds = chrono::duration<double>(chrono::steady_clock::now() - stage_start).count();
+        observer.stage_end(progress);
+    }
+}
+
+template <typename T, typename Alloc, typename Observer>
+matrix<T, Alloc> csv<T, Alloc, Observer>::get_rows(const uint64_t &first, const uint64_t &count, bool const &row_num)
+{
+    if (row_offsets.empty())
+    {
+        if (options.index_step == 0)
+        {
+            options.index_step = 1024;
+        }
+        stage_begin(load_stage::open);
+        count_rows();
+    }
+    if (count == 0 or first >= NLines or count > NLines - first)
+    {
+        throw typename csv::row_invalid();
+    }
+    errors.clear();
+    NErrors = 0;
+    // Starting at the closest indexed row before the first one, and skipping the rows in between
+    uint64_t indexed = first / options.index_step;
+    csv_detail::line_reader input(datafile, row_offsets[indexed], 0);
+    if (!input.is_open())
+    {
+        throw typename csv::file_notfound(datafile);
+    }
+    string_view line;
+    uint64_t offset = row_offsets[indexed];
+    for (uint64_t i = indexed * options.index_step; i < first; i++)
+    {
+        if (!input.next(line))
+        {
+            throw typename csv::input_failed();
+        }
+        offset += line.size() + 1;
+    }
+
+    uint64_t width = (row_num == true) ? NSelected + 1 : NSelected;
+    vector<T, Alloc> elements(count * width, allocator);
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        if (!input.next(line)) // The file has changed since it was indexed
+        {
+            throw typename csv::input_failed();
+        }
+        uint64_t start = offset;
+        offset += line.size() + 1;
+        if (!line.empty() and line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        T *row = &elements[kept * width];
+        if (row_num == true)
+        {
+            row[0] = (T)(first + i + 1);
+            row++;
+        }
+        csv_detail::row_status status = read_rows(line, row);
+        if (status.valid or keep_row(status, first + i + 1, start, errors, NErrors))
+        {
+            kept++;
+        }
+    }
+    if (kept == 0) // All the rows were left out
+    {
+        throw typename csv::row_invalid();
+    }
+    elements.resize(kept * width);
+    return matrix<T, Alloc>(kept, width, std::move(elements));
+}
+
+template <typename T, typename Alloc, typename Observer>
+matrix<T, Alloc> csv<T, Alloc, Observer>::get_row(const uint64_t &row, bool const &row_num)
+{
+    return get_rows(row, 1, row_num);
+}
+
+template <typename T, typename Alloc, typename Observer>
+uint64_t csv<T, Alloc, Observer>::refresh(matrix<T, Alloc> &data, bool const &row_num)
+{
+    uint64_t width = (row_num == true) ? NSelected + 1 : NSelected;
+    // Continuing after the previous call only if the file up to there, and the data set, are still the same.
+    // The positions in a compressed file are those of the decompressed text, so it is decompressed again from the start,
+    // and the text read before is checked while it is skipped, with a hash of all of it (the file itself may be rewritten)
+    bool plain = compressed == csv_detail::compression::none;
+    bool resume = tail_offset > 0 and data.get_rows() == tail_rows and data.get_cols() == width and tail_codes == dictionary_sizes() and
+                  (!plain or csv_detail::prefix_hash(datafile, tail_offset) == tail_hash);
+    uint64_t offset = (resume and plain) ? tail_offset : NChar;
+    uint64_t text_hash = csv_detail::fnv1a(14695981039346656037ULL, (const char *)&NChar, sizeof(NChar)); // Of the decompressed text read
+    uint64_t numbered = resume ? Row_numbers.size() : 0; // Restored if the new rows cannot be read
+
+    auto input = make_unique<csv_detail::line_reader>(datafile, offset, options.prefetch);
+    if (!input->is_open())
+    {
+        throw typename csv::file_notfound(datafile);
+    }
+    vector<T, Alloc> elements(allocator); // The new rows
+    string_view line;
+    errors.clear();
+    NErrors = 0;
+    stage_begin(load_stage::parse);
+    if (resume and !plain)
+    {
+        while (offset < tail_offset and input->next(line) and input->line_complete())
+        {
+            offset += line.size() + 1;
+            text_hash = csv_detail::fnv1a(csv_detail::fnv1a(text_hash, line.data(), line.size()), "\n", 1);
+        }
+        if (input->failed())
+        {
+            throw typename csv::input_failed();
+        }
+        if (offset != tail_offset or text_hash != tail_hash)
+        {
+            // The text read before has changed, so all the rows are read again
+            resume = false;
+            offset = NChar;
+            text_hash = csv_detail::fnv1a(14695981039346656037ULL, (const char *)&NChar, sizeof(NChar));
+            input = make_unique<csv_detail::line_reader>(datafile, offset, options.prefetch);
+        }
+    }
+    uint64_t rows = resume ? tail_rows : 0;
+    uint64_t lines = resume ? tail_lines : 0;
+    try
+    {
+        if (!resume)
+        {
+            Row_numbers.clear();
+            for (csv_detail::dictionary &dictionary : dictionaries)
+            {
+                dictionary.clear();
+            }
+        }
+        while (input->next(line) and input->line_complete())
+        {
+            uint64_t start = offset;
+            offset += line.size() + 1;
+            if (!plain)
+            {
+                text_hash = csv_detail::fnv1a(csv_detail::fnv1a(text_hash, line.data(), line.size()), "\n", 1);
+            }
+            if (!line.empty() and line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
+            lines++;
+            elements.resize(elements.size() + width);
+            T *row = &elements[elements.size() - width];
+            if (row_num == true)
+            {
+                Row_numbers.push_back((T)lines);
+                row[0] = (T)lines;
+                row++;
+            }
+            csv_detail::row_status status = read_rows(line, row);
+            if (status.valid or keep_row(status, lines, start, errors, NErrors))
+            {
+                rows++;
+            }
+            else
+            {
+                elements.resize(elements.size() - width);
+                if (row_num == true)
+                {
+                    Row_numbers.pop_back();
+                }
+            }
+        }
+        if (input->failed())
+        {
+            throw typename csv::input_failed();
+        }
+    }
+    catch (...)
+    {
+        Row_numbers.resize(numbered);
+        throw;
+    }
+
+    uint64_t added = rows - (resume ? tail_rows : 0);
+    if (added > 0)
+    {
+        if (resume)
+        {
+            data.append_rows(span<const T>(elements));
+        }
+        else
+        {
+            data = matrix<T, Alloc>(added, width, std::move(elements));
+        }
+    }
+    stage_end(offset - ((resume and plain) ? tail_offset : NChar), added);
+    if (added == 0 and !resume)
+    {
+        return 0; // A matrix cannot be empty, so the next call starts over
+    }
+    tail_offset = offset;
+    tail_rows = rows;
+    tail_lines = lines;
+    NLines = lines;
+    tail_hash = plain ? csv_detail::prefix_hash(datafile, offset) : text_hash;
+    tail_codes = dictionary_sizes();
+    NRows = rows;
+    return added;
+}
+
+template <typename T, typename Alloc, typename Observer>
+vector<uint64_t> csv<T, Alloc, Observer>::dictionary_sizes() const
+{
+    vector<uint64_t> sizes;
+    for (const csv_detail::dictionary &dictionary : dictionaries)
+    {
+        sizes.push_back(dictionary.get_values().size());
+    }
+    return sizes;
+}
+
+template <typename T, typename Alloc, typename Observer>
+bool csv<T, Alloc, Observer>::load_index()
+{
+    ifstream input(datafile + ".index", ios::binary);
+    csv_detail::index_header saved;
+    if (!input.read((char *)&saved, sizeof(saved)))
+    {
+        return false;
+    }
+    csv_detail::index_header current;
+    if (!csv_detail::fingerprint(datafile, current.source_size, current.source_time, current.source_hash))
+    {
+        return false;
+    }
+    if (memcmp(saved.magic, current.magic, sizeof(current.magic)) != 0 or saved.source_size != current.source_size or
+        saved.source_time != current.source_time or saved.source_hash != current.source_hash or
+        saved.NChar != NChar or saved.step != options.index_step or saved.NOffsets == 0)
+    {
+        return false;
+    }
+    vector<uint64_t> offsets(saved.NOffsets);
+    if (!input.read((char *)offsets.data(), (streamsize)(offsets.size() * sizeof(uint64_t))))
+    {
+        return false;
+    }
+    NRows = saved.NRows;
+    NLines = NRows;
+    row_offsets = std::move(offsets);
+    return true;
+}
+
+template <typename T, typename Alloc, typename Observer>
+void csv<T, Alloc, Observer>::save_index() const
+{
+    csv_detail::index_header header;
+    if (!csv_detail::fingerprint(datafile, header.source_size, header.source_time, header.source_hash))
+    {
+        return;
+    }
+    header.NChar = NChar;
+    header.NRows = NRows;
+    header.step = options.index_step;
+    header.NOffsets = row_offsets.size();
+    // Writing to a temporary file first, so that a reader never sees a partial index
+    string name = datafile + ".index";
+    {
+        ofstream output(name + ".tmp", ios::binary | ios::trunc);
+        if (!output.is_open())
+        {
+            return;
+        }
+        output.write((const char *)&header, sizeof(header));
+        output.write((const char *)row_offsets.data(), (streamsize)(row_offsets.size() * sizeof(uint64_t)));
+        if (!output)
+        {
+            output.close();
+            remove((name + ".tmp").c_str());
+            return;
+        }
+    }
+    error_code error;
+    filesystem::rename(name + ".tmp", name, error);
+}
+
+template <typename T, typename Alloc, typename Observer>
+table csv<T, Alloc, Observer>::read_table(const vector<column_type> &types)
+{
+    if (types.size() != NSelected)
+    {
+        throw typename csv::schema_invalid();
+    }
+    csv_detail::line_reader input(datafile, NChar, options.prefetch); // Skipping the headers line
+    if (!input.is_open())
+    {
+        throw typename csv::file_notfound(datafile);
+    }
+    table result(get_column_names(), types);
+    result.reserve(NRows); // Known here unless the rows are only counted while parsing
+
+    string_view line;
+    uint64_t i = 0;    // Lines read
+    uint64_t rows = 0; // Rows kept
+    uint64_t bytes = 0;
+    errors.clear();
+    NErrors = 0;
+    stage_begin(load_stage::parse);
+    while (input.next(line))
+    {
+        uint64_t start = bytes;
+        bytes += line.size() + 1;
+        if (!line.empty() and line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        i++;
+        csv_detail::row_status status = split_row(line, [&](const uint64_t &slot, string_view value)
+                                                  { return result.append(slot, value); });
+        if (status.valid)
+        {
+            rows++;
+        }
+        else if (keep_row(status, i, NChar + start, errors, NErrors))
+        {
+            rows++;
+            result.pad(rows, options.fill_value);
+        }
+        else
+        {
+            result.truncate(rows);
+        }
+        if ((i & progress_mask) == 0)
+        {
+            stage_progress(bytes, rows);
+        }
+    }
+    if (input.failed())
+    {
+        throw typename csv::input_failed();
+    }
+    result.rows = rows;
+    NRows = rows;
+    NLines = i;
+    stage_end(bytes, rows);
+    return result;
+}
+
+template <typename T, typename Alloc, typename Observer>
+vector<T, Alloc> csv<T, Alloc, Observer>::parse(bool const &row_num, bool const &column_major)
+{
+    if (options.cache == true)
+    {
+        vector<T, Alloc> elements(allocator);
+        if (load_cache(row_num, column_major, elements))
+        {
+            return elements;
+        }
+        options.cache = false; // Parsing without the cache, and then saving it
+        try
+        {
+            elements = parse(row_num, column_major);
+        }
+        catch (...)
+        {
+            options.cache = true;
+            throw;
+        }
+        options.cache = true;
+        stage_begin(load_stage::cache_save);
+        save_cache(row_num, column_major, elements);
+        stage_end(NRows * NSelected * sizeof(T), NRows);
+        return elements;
+    }
+    for (csv_detail::dictionary &dictionary : dictionaries)
+    {
+        dictionary.clear(); // The codes are given again from 0 for every data set read
+    }
+    errors.clear();
+    NErrors = 0;
+    if (compressed != csv_detail::compression::none)
+    {
+        return parse_compressed(row_num, column_major);
+    }
+    uint64_t NThreads = (options.threads == 0) ? max<uint64_t>(thread::hardware_concurrency(), 1) : options.threads;
+    // The single-pass reader does not know the number of rows in advance, so a column-major result is counted first
+    if (NThreads > 1 or (options.mode == load_mode::mapped and column_major == true))
+    {
+        if (mapping == nullptr)
+        {
+            csv_detail::mapped_file file(datafile);
+            if (!file.is_open())
+            {
+                throw typename csv::file_notfound(datafile);
+            }
+            return parse_parallel(row_num, column_major, file, NThreads);
+        }
+        return parse_parallel(row_num, column_major, *mapping, NThreads);
+    }
+    if (options.mode == load_mode::mapped)
+    {
+        return parse_mapped(row_num);
+    }
+    return parse_stream(row_num, column_major);
+}
+
+template <typename T, typename Alloc, typename Observer>
+vector<T, Alloc> csv<T, Alloc, Observer>::parse_stream(bool const &row_num, bool const &column_major)
+{
+    // To start reading the data again, skipping the headers line
+    csv_detail::line_reader input(datafile, NChar, options.prefetch);
+    if (!input.is_open())
+    {
+        throw typename csv::file_notfound(datafile);
+    }
+
+    uint64_t width = (row_num == true) ? NSelected + 1 : NSelected;
+    vector<T, Alloc> Matrix_elements(NLines * width, allocator); // The storage of the result
+    Row_numbers = vector<T>(NLines);
+    uint64_t i = 0;    // Lines read
+    uint64_t rows = 0; // Rows kept
+    uint64_t bytes = 0;
+    string_view line; // Points into the reused buffer of the reader
+    stage_begin(load_stage::parse);
+    while (input.next(line))
+    {
+        if (i == NLines) // The file has grown since it was counted in the constructor
+        {
+            throw typename csv::input_failed();
+        }
+        uint64_t start = bytes;
+        bytes += line.size() + 1;
+        if (!line.empty() and line.back() == '\r')
+        {
+            line.remove_suffix(1); // Leaving only the values of a "\r\n" line
+        }
+        // In a column-major result, the values of a row are NLines apart (until the result is compacted)
+        T *row = (column_major == true) ? &Matrix_elements[rows] : &Matrix_elements[rows * width];
+        uint64_t stride = (column_major == true) ? NLines : 1;
+        if (row_num == true)
+        {
+            Row_numbers[rows] = (T)(i + 1);
+            row[0] = Row_numbers[rows];
+            row += stride;
+        }
+        csv_detail::row_status status = read_rows(line, row, stride);
+        i++;
+        // A row that is left out is overwritten by the next one
+        if (status.valid or keep_row(status, i, NChar + start, errors, NErrors))
+        {
+            rows++;
+        }
+        if ((i & progress_mask) == 0)
+        {
+            stage_progress(bytes, rows);
+        }
+    }
+    if (input.failed())
+    {
+        throw typename csv::input_failed();
+    }
+    compact(Matrix_elements, rows, NLines, width, column_major);
+    Row_numbers.resize(rows);
+    NRows = rows;
+    stage_end(bytes, rows);
+    return Matrix_elements;
+}
+
+template <typename T, typename Alloc, typename Observer>
+vector<T, Alloc> csv<T, Alloc, Observer>::parse_compressed(bool const &row_num, bool const &column_major)
+{
+    csv_detail::line_reader input(datafile, NChar, options.prefetch); // Skipping the headers line
+    if (!input.is_open())
+    {
+        throw typename csv::file_notfound(datafile);
+    }
+
+    uint64_t width = (row_num == true) ? NSelected + 1 : NSelected;
+    NRows = 0;
+    NLines = 0;
+    Row_numbers.clear();
+    vector<T, Alloc> Matrix_elements(allocator); // The storage of the result
+    uint64_t capacity = 0;                       // Rows there is room for (the distance between columns if column-major)
+    string_view line;
+    uint64_t bytes = 0;
+    stage_begin(load_stage::parse);
+    while (input.next(line))
+    {
+        uint64_t start = bytes;
+        bytes += line.size() + 1;
+        if (!line.empty() and line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        NLines++;
+        if (NRows == capacity)
+        {
+            // The number of rows is not known in advance, so the room doubles; in a column-major result, the columns
+            // are then moved apart (from the last one, so that none is overwritten before it is moved)
+            uint64_t grown = max<uint64_t>(capacity * 2, 1024);
+            Matrix_elements.resize(grown * width);
+            if (column_major == true)
+            {
+                for (uint64_t j = width; j > 1; j--)
+                {
+                    copy_backward(Matrix_elements.begin() + (int64_t)((j - 1) * capacity), Matrix_elements.begin() + (int64_t)((j - 1) * capacity + NRows), Matrix_elements.begin() + (int64_t)((j - 1) * grown + NRows));
+                }
+            }
+            capacity = grown;
+        }
+        // In a column-major result, the values of a row are capacity apart (until the result is compacted)
+        T *row = (column_major == true) ? &Matrix_elements[NRows] : &Matrix_elements[NRows * width];
+        uint64_t stride = (column_major == true) ? capacity : 1;
+        if (row_num == true)
+        {
+            Row_numbers.push_back((T)NLines);
+            row[0] = (T)NLines;
+            row += stride;
+        }
+        csv_detail::row_status status = read_rows(line, row, stride);
+        if (status.valid or keep_row(status, NLines, NChar + start, errors, NErrors))
+        {
+            NRows++;
+        }
+        else if (row_num == true)
+        {
+            Row_numbers.pop_back();
+        }
+        if ((NLines & progress_mask) == 0)
+        {
+            stage_progress(bytes, NRows);
+        }
+    }
+    if (input.failed())
+    {
+        throw typename csv::input_failed();
+    }
+    compact(Matrix_elements, NRows, capacity, width, column_major);
+    stage_end(bytes, NRows);
+    return Matrix_elements;
+}
+
+template <typename T, typename Alloc, typename Observer>
+vector<T, Alloc> csv<T, Alloc, Observer>::parse_mapped(bool const &row_num)
+{
+    const char *begin = mapping->data() + NChar;
+    const char *first = begin;
+    const char *last = mapping->data() + mapping->size();
+
+    uint64_t width = (row_num == true) ? NSelected + 1 : NSelected;
+    NRows = 0;
+    NLines = 0;
+    Row_numbers.clear();
+    vector<T, Alloc> Matrix_elements(allocator); // The storage of the result
+    // Counting the lines of the mapped file is cheap next to parsing them, and sizes the buffer exactly,
+    // so it is never reallocated (only the rows that are left out leave unused room)
+    Matrix_elements.reserve(csv_detail::count_lines(first, last) * width);
+
+    stage_begin(load_stage::parse);
+    while (first < last)
+    {
+        const char *end = (const char *)memchr(first, '\n', (size_t)(last - first));
+        if (end == nullptr)
+        {
+            end = last; // The last line does not have to end with a line break
+        }
+        string_view line(first, (size_t)(end - first));
+        if (!line.empty() and line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        NLines++;
+        Matrix_elements.resize((NRows + 1) * width); // Stays within the reserved capacity
+        T *row = &Matrix_elements[NRows * width];
+        if (row_num == true)
+        {
+            Row_numbers.push_back((T)NLines);
+            row[0] = (T)NLines;
+            row++;
+        }
+        csv_detail::row_status status = read_rows(line, row);
+        if (status.valid or keep_row(status, NLines, (uint64_t)(first - mapping->data()), errors, NErrors))
+        {
+            NRows++;
+        }
+        else if (row_num == true)
+        {
+            Row_numbers.pop_back();
+        }
+        if ((NLines & progress_mask) == 0)
+        {
+            stage_progress((uint64_t)(end - begin), NRows);
+        }
+        first = end + 1;
+    }
+    Matrix_elements.resize(NRows * width);
+    stage_end((uint64_t)(last - begin), NRows);
+    return Matrix_elements;
+}
+
+template <typename T, typename Alloc, typename Observer>
+vector<T, Alloc> csv<T, Alloc, Observer>::parse_parallel(bool const &row_num, bool const &column_major, const csv_detail::mapped_file &file, const uint64_t &NThreads)
+{
+    const char *begin = file.data() + NChar;
+    const char *last = file.data() + file.size();
+    uint64_t size = (uint64_t)(last - begin);
+    uint64_t width = (row_num == true) ? NSelected + 1 : NSelected;
+    // Small files are not worth splitting
+    uint64_t min_chunk = 1 << 16;
+    uint64_t NChunks = min(NThreads, size / min_chunk + 1);
+
+    // Splitting the rows into chunks of about the same size, each one starting at the beginning of a line
+    vector<const char *> bounds(NChunks + 1);
+    bounds[0] = begin;
+    bounds[NChunks] = last;
+    for (uint64_t k = 1; k < NChunks; k++)
+    {
+        const char *middle = max(begin + size * k / NChunks, bounds[k - 1]);
+        const char *end = (const char *)memchr(middle, '\n', (size_t)(last - middle));
+        bounds[k] = (end == nullptr) ? last : end + 1;
+    }
+
+    // Counting the rows of each chunk, and finding the first empty line in it
+    vector<uint64_t> chunk_rows(NChunks, 0);
+    vector<uint64_t> empty_row(NChunks, UINT64_MAX);
+    stage_begin(load_stage::parse);
+    csv_detail::run_in_parallel(NChunks, [&](uint64_t k)
+                                {
+        uint64_t rows = 0;
+        const char *first = bounds[k];
+        while (first < bounds[k + 1])
+        {
+            const char *end = (const char *)memchr(first, '\n', (size_t)(bounds[k + 1] - first));
+            if (end == nullptr)
+            {
+                end = bounds[k + 1];
+            }
+            if ((end == first or (end == first + 1 and *first == '\r')) and empty_row[k] == UINT64_MAX)
+            {
+                empty_row[k] = rows;
+            }
+            rows++;
+            first = end + 1;
+        }
+        chunk_rows[k] = rows; });
+
+    // Each chunk writes its rows after the rows of the previous chunks
+    vector<uint64_t> first_row(NChunks + 1, 0);
+    for (uint64_t k = 0; k < NChunks; k++)
+    {
+        first_row[k + 1] = first_row[k] + chunk_rows[k];
+    }
+    NLines = first_row[NChunks];
+    vector<T, Alloc> Matrix_elements(NLines * width, allocator); // The storage of the result
+    Row_numbers = vector<T>(NLines);
+
+    vector<exception_ptr> failures(NChunks);
+    // Every chunk keeps its own error log, and writes its kept rows from its first row on
+    vector<vector<parse_error>> chunk_errors(NChunks);
+    vector<uint64_t> chunk_NErrors(NChunks, 0);
+    vector<uint64_t> chunk_kept(NChunks, 0);
+    // Every chunk encodes the text columns with its own dictionaries, which are merged after parsing
+    vector<vector<csv_detail::dictionary>> chunk_dictionaries(encoded.empty() ? 0 : NChunks, vector<csv_detail::dictionary>(NSelected));
+    // The cells of encoded columns filled in error_mode::fill (row, slot), which hold the fill value instead of a code
+    vector<vector<pair<uint64_t, uint64_t>>> chunk_filled(encoded.empty() ? 0 : NChunks);
+    csv_detail::run_in_parallel(NChunks, [&](uint64_t k)
+                                {
+        try
+        {
+            // In strict mode, a chunk is parsed up to its first empty line, just like the serial reader would stop there
+            uint64_t i = first_row[k];
+            uint64_t stop = (empty_row[k] == UINT64_MAX or options.errors != error_mode::strict) ? first_row[k + 1] : first_row[k] + empty_row[k];
+            uint64_t kept = first_row[k];
+            const char *first = bounds[k];
+            while (i < stop)
+            {
+                const char *end = (const char *)memchr(first, '\n', (size_t)(bounds[k + 1] - first));
+                if (end == nullptr)
+                {
+                    end = bounds[k + 1];
+                }
+                string_view line(first, (size_t)(end - first));
+                if (!line.empty() and line.back() == '\r')
+                {
+                    line.remove_suffix(1);
+                }
+                // In a column-major result, the values of a row are NLines apart (until the result is compacted)
+                T *row = (column_major == true) ? &Matrix_elements[kept] : &Matrix_elements[kept * width];
+                uint64_t stride = (column_major == true) ? NLines : 1;
+                if (row_num == true)
+                {
+                    Row_numbers[kept] = (T)(i + 1);
+                    row[0] = Row_numbers[kept];
+                    row += stride;
+                }
+                csv_detail::row_status status = read_rows(line, row, stride, encoded.empty() ? nullptr : &chunk_dictionaries[k]);
+                if (!status.valid and options.errors == error_mode::fill and !encoded.empty())
+                {
+                    // An encoded field always gets a code, so only the missing columns of a short row are filled
+                    for (uint64_t j = status.fields; j < NCols; j++)
+                    {
+                        if (column_slot[j] != UINT64_MAX and encoded[column_slot[j]])
+                        {
+                            chunk_filled[k].push_back({kept, column_slot[j]});
+                        }
+                    }
+                }
+                i++;
+                if (status.valid or keep_row(status, i, (uint64_t)(first - file.data()), chunk_errors[k], chunk_NErrors[k]))
+                {
+                    kept++;
+                }
+                first = end + 1;
+            }
+            chunk_kept[k] = kept - first_row[k];
+        }
+        catch (...)
+        {
+            failures[k] = current_exception();
+        } });
+
+    // Reporting the first problem in the order of the file, as the serial reader would
+    for (uint64_t k = 0; k < NChunks; k++)
+    {
+        if (failures[k] != nullptr)
+        {
+            rethrow_exception(failures[k]);
+        }
+        if (empty_row[k] != UINT64_MAX and options.errors == error_mode::strict)
+        {
+            throw typename csv::empty_line(first_row[k] + empty_row[k] + 1);
+        }
+    }
+    for (uint64_t k = 0; k < NChunks; k++)
+    {
+        for (uint64_t e = 0; e < chunk_errors[k].size() and errors.size() < options.max_errors; e++)
+        {
+            errors.push_back(chunk_errors[k][e]);
+        }
+        NErrors += chunk_NErrors[k];
+    }
+    if (!encoded.empty())
+    {
+        // Merging the dictionaries in the order of the file gives the same codes as the serial reader,
+        // and then the codes of each chunk are translated in parallel
+        vector<vector<vector<uint64_t>>> translation(NChunks, vector<vector<uint64_t>>(NSelected));
+        for (uint64_t k = 0; k < NChunks; k++)
+        {
+            for (uint64_t slot = 0; slot < NSelected; slot++)
+            {
+                for (const string &value : chunk_dictionaries[k][slot].get_values())
+                {
+                    translation[k][slot].push_back(dictionaries[slot].encode(value));
+                }
+            }
+        }
+        csv_detail::run_in_parallel(NChunks, [&](uint64_t k)
+                                    {
+            for (uint64_t slot = 0; slot < NSelected; slot++)
+            {
+                if (!encoded[slot])
+                {
+                    continue;
+                }
+                uint64_t col = (row_num == true) ? slot + 1 : slot;
+                for (uint64_t i = first_row[k]; i < first_row[k] + chunk_kept[k]; i++)
+                {
+                    T &code = (column_major == true) ? Matrix_elements[col * NLines + i] : Matrix_elements[i * width + col];
+                    // Only a filled cell can hold something else than a code (such as NaN), and it is put back below
+                    if (code == code and code >= (T)0 and (uint64_t)code < translation[k][slot].size())
+                    {
+                        code = (T)translation[k][slot][(uint64_t)code];
+                    }
+                }
+            }
+            // The fill value might look like a code, so the filled cells are written again after the translation
+            for (const auto &[i, slot] : chunk_filled[k])
+            {
+                uint64_t col = (row_num == true) ? slot + 1 : slot;
+                T &cell = (column_major == true) ? Matrix_elements[col * NLines + i] : Matrix_elements[i * width + col];
+                cell = filler;
+            } });
+    }
+
+    // Moving the rows of every chunk after the rows kept by the previous chunks
+    NRows = 0;
+    for (uint64_t k = 0; k < NChunks; k++)
+    {
+        if (NRows != first_row[k])
+        {
+            if (column_major == true)
+            {
+                for (uint64_t j = 0; j < width; j++)
+                {
+                    auto column = Matrix_elements.begin() + (int64_t)(j * NLines);
+                    copy(column + (int64_t)first_row[k], column + (int64_t)(first_row[k] + chunk_kept[k]), column + (int64_t)NRows);
+                }
+            }
+            else
+            {
+                copy(Matrix_elements.begin() + (int64_t)(first_row[k] * width), Matrix_elements.begin() + (int64_t)((first_row[k] + chunk_kept[k]) * width),
+                     Matrix_elements.begin() + (int64_t)(NRows * width));
+            }
+            copy(Row_numbers.begin() + (int64_t)first_row[k], Row_numbers.begin() + (int64_t)(first_row[k] + chunk_kept[k]), Row_numbers.begin() + (int64_t)NRows);
+        }
+        NRows += chunk_kept[k];
+    }
+    compact(Matrix_elements, NRows, NLines, width, column_major);
+    Row_numbers.resize(NRows);
+    stage_end(size, NRows);
+    return Matrix_elements;
+}
+
+template <typename T, typename Alloc, typename Observer>
+string csv<T, Alloc, Observer>::cache_name() const
+{
+    return options.cache_file.empty() ? datafile + ".cache" : options.cache_file;
+}
+
+template <typename T, typename Alloc, typename Observer>
+bool csv<T, Alloc, Observer>::describe_cache(csv_detail::cache_header &header) const
+{
+    header.value_size = sizeof(T);
+    if constexpr (is_floating_point_v<T>)
+        header.value_kind = 2;
+    else if constexpr (is_integral_v<T> and is_signed_v<T>)
+        header.value_kind = 0;
+    else if constexpr (is_integral_v<T>)
+        header.value_kind = 1;
+    else
+        header.value_kind = 3;
+    header.selection_hash = csv_detail::fnv1a(14695981039346656037ULL, (const char *)column_slot.data(), column_slot.size() * sizeof(uint64_t));
+    // Values parsed with another dialect are not the same
+    const char dialect[3] = {options.dialect.delimiter, options.dialect.quote, (char)options.dialect.trim};
+    header.selection_hash = csv_detail::fnv1a(header.selection_hash, dialect, sizeof(dialect));
+    header.NCols = NCols;
+    header.NSelected = NSelected;
+    header.NChar = NChar;
+    header.header_size = headers.size();
+    return csv_detail::fingerprint(datafile, header.source_size, header.source_time, header.source_hash);
+}
+
+template <typename T, typename Alloc, typename Observer>
+bool csv<T, Alloc, Observer>::cache_valid(const csv_detail::cache_header &cached) const
+{
+    if constexpr (!is_trivially_copyable_v<T>)
+    {
+        return false;
+    }
+    csv_detail::cache_header current;
+    if (!describe_cache(current))
+    {
+        return false;
+    }
+    return memcmp(cached.magic, current.magic, sizeof(current.magic)) == 0 and cached.value_size == current.value_size and
+           cached.value_kind == current.value_kind and cached.source_size == current.source_size and
+           cached.source_time == current.source_time and cached.source_hash == current.source_hash and
+           cached.selection_hash == current.selection_hash and cached.NCols == current.NCols and
+           cached.NSelected == current.NSelected and cached.NChar == current.NChar and cached.header_size == current.header_size;
+}
+
+template <typename T, typename Alloc, typename Observer>
+bool csv<T, Alloc, Observer>::load_cache(bool const &row_num, bool const &column_major, vector<T, Alloc> &elements)
+{
+    if constexpr (!is_trivially_copyable_v<T>)
+    {
+        return false;
+    }
+    else
+    {
+        csv_detail::mapped_file cache(cache_name());
+        csv_detail::cache_header cached;
+        if (!cache.is_open() or cache.size() < sizeof(cached))
+        {
+            return false;
+        }
+        memcpy(&cached, cache.data(), sizeof(cached));
+        uint64_t offset = csv_detail::cache_payload_offset(cached.header_size);
+        if (!cache_valid(cached) or cache.size() != offset + cached.NRows * cached.NSelected * sizeof(T) or
+            string_view(cache.data() + sizeof(cached), cached.header_size) != headers)
+        {
+            return false;
+        }
+
+        stage_begin(load_stage::cache_load);
+        NRows = cached.NRows;
+        uint64_t width = (row_num == true) ? NSelected + 1 : NSelected;
+        const char *values = cache.data() + offset;
+        Row_numbers = vector<T>(NRows);
+        elements.resize(NRows * width);
+        uint64_t first_col = (row_num == true) ? 1 : 0;
+        // The rows are copied in slices of 65536, and the progress is reported after each slice
+        for (uint64_t first = 0; first < NRows; first += progress_mask + 1)
+        {
+            uint64_t last = min(NRows, first + progress_mask + 1);
+            if (row_num == false and column_major == false)
+            {
+                // The cache has exactly the layout of the result
+                memcpy(&elements[first * width], values + first * width * sizeof(T), (last - first) * width * sizeof(T));
+            }
+            else
+            {
+                for (uint64_t i = first; i < last; i++)
+                {
+                    const char *row = values + i * NSelected * sizeof(T);
+                    if (column_major == true)
+                    {
+                        for (uint64_t j = 0; j < NSelected; j++)
+                        {
+                            memcpy(&elements[(j + first_col) * NRows + i], row + j * sizeof(T), sizeof(T));
+                        }
+                    }
+                    else
+                    {
+                        memcpy(&elements[i * width + first_col], row, NSelected * sizeof(T));
+                    }
+                    if (row_num == true)
+                    {
+                        Row_numbers[i] = (T)(i + 1);
+                        elements[(column_major == true) ? i : i * width] = Row_numbers[i];
+                    }
+                }
+            }
+            stage_progress(last * NSelected * sizeof(T), last);
+        }
+        stage_end(NRows * NSelected * sizeof(T), NRows);
+        return true;
+    }
+}
+
+template <typename T, typename Alloc, typename Observer>
+void csv<T, Alloc, Observer>::save_cache(bool const &row_num, bool const &column_major, const vector<T, Alloc> &elements)
+{
+    if constexpr (is_trivially_copyable_v<T>)
+    {
+        csv_detail::cache_header header;
+        if (!describe_cache(header))
+        {
+            return;
+        }
+        header.NRows = NRows;
+        // Writing to a temporary file first, so that a reader never sees a partial cache
+        string temporary = cache_name() + ".tmp";
+        {
+            ofstream output(temporary, ios::binary | ios::trunc);
+            if (!output.is_open())
+            {
+                return;
+            }
+            output.write((const char *)&header, sizeof(header));
+            output.write(headers.data(), (streamsize)headers.size());
+            vector<char> padding(csv_detail::cache_payload_offset(headers.size()) - sizeof(header) - headers.size(), 0);
+            output.write(padding.data(), (streamsize)padding.size());
+            uint64_t width = (row_num == true) ? NSelected + 1 : NSelected;
+            uint64_t first_col = (row_num == true) ? 1 : 0;
+            // The rows are written in slices of 65536, and the progress is reported after each slice
+            for (uint64_t first = 0; first < NRows; first += progress_mask + 1)
+            {
+                uint64_t last = min(NRows, first + progress_mask + 1);
+                if (row_num == false and column_major == false)
+                {
+                    output.write((const char *)&elements[first * width], (streamsize)((last - first) * width * sizeof(T)));
+                }
+                else
+                {
+                    for (uint64_t i = first; i < last; i++)
+                    {
+                        for (uint64_t j = first_col; j < width; j++)
+                        {
+                            const T &value = (column_major == true) ? elements[j * NRows + i] : elements[i * width + j];
+                            output.write((const char *)&value, sizeof(T));
+                        }
+                    }
+                }
+                stage_progress(last * NSelected * sizeof(T), last);
+            }
+            if (!output)
+            {
+                output.close();
+                error_code ignored;
+                filesystem::remove(temporary, ignored);
+                return;
+            }
+        }
+        error_code error;
+        filesystem::rename(temporary, cache_name(), error);
+        if (error)
+        {
+            filesystem::remove(temporary, error);
+        }
+    }
+}
+
+template <typename T, typename Alloc, typename Observer>
+inline uint64_t csv<T, Alloc, Observer>::get_NCols() const
+{
+    return NSelected;
+}
+
+template <typename T, typename Alloc, typename Observer>
+vector<string> csv<T, Alloc, Observer>::get_column_names() const
+{
+    vector<string> names(NSelected);
+    for (uint64_t j = 0; j < NCols; j++)
+    {
+        if (column_slot[j] != UINT64_MAX)
+        {
+            names[column_slot[j]] = column_names[j];
+        }
+    }
+    return names;
+}
+
+template <typename T, typename Alloc, typename Observer>
+inline uint64_t csv<T, Alloc, Observer>::get_NRows() const
+{
+    return NRows;
+}
+
+template <typename T, typename Alloc, typename Observer>
+inline const string &csv<T, Alloc, Observer>::get_header() const
+{
+    return headers;
+}
+
+template <typename T, typename Alloc, typename Observer>
+inline span<const T> csv<T, Alloc, Observer>::get_row_numbers() const
+{
+    return span<const T>(Row_numbers);
+}
+
+template <typename T, typename Alloc, typename Observer>
+const vector<string> &csv<T, Alloc, Observer>::get_dictionary(const uint64_t &col) const
+{
+    if (col >= NSelected)
+    {
+        throw typename csv::column_invalid(to_string(col));
+    }
+    return dictionaries[col].get_values();
+}
+
+template <typename T, typename Alloc, typename Observer>
+const csv_dialect &csv<T, Alloc, Observer>::get_dialect() const
+{
+    return options.dialect;
+}
+
+template <typename T, typename Alloc, typename Observer>
+const vector<parse_error> &csv<T, Alloc, Observer>::get_errors() const
+{
+    return errors;
+}
+
+template <typename T, typename Alloc, typename Observer>
+inline uint64_t csv<T, Alloc, Observer>::get_NErrors() const
+{
+    return NErrors;
+}
+
+template <typename T, typename Alloc, typename Observer>
+typename csv<T, Alloc, Observer>::batch_range csv<T, Alloc, Observer>::batches(uint64_t const &batch_rows, bool const &row_num)
+{
+    for (csv_detail::dictionary &dictionary : dictionaries)
+    {
+        dictionary.clear(); // The codes stay the same from one batch to the next
+    }
+    errors.clear();
+    NErrors = 0;
+    stage_begin(load_stage::parse);
+    return batch_range(this, batch_rows, row_num);
+}
+
+template <typename T, typename Alloc, typename Observer>
+csv<T, Alloc, Observer>::batch_range::batch_range(csv *_source, const uint64_t &_batch_rows, bool const &_row_num)
+    : source(_source), batch_rows(max<uint64_t>(_batch_rows, 1)), row_num(_row_num),
+      width((_row_num == true) ? _source->NSelected + 1 : _source->NSelected),
+      input(_source->datafile, _source->NChar, _source->options.prefetch) // Skipping the headers line
+{
+    if (!input.is_open())
+    {
+        throw typename csv::file_notfound(_source->datafile);
+    }
+    values.resize(batch_rows * width);
+    current.elements = values.data();
+    current.cols = width;
+}
+
+template <typename T, typename Alloc, typename Observer>
+typename csv<T, Alloc, Observer>::batch_range::iterator csv<T, Alloc, Observer>::batch_range::begin()
+{
+    return next() ? iterator(this) : iterator();
+}
+
+template <typename T, typename Alloc, typename Observer>
+bool csv<T, Alloc, Observer>::batch_range::next()
+{
+    uint64_t rows = 0;
+    while (rows < batch_rows)
+    {
+        string_view line;
+        if (!input.next(line))
+        {
+            break;
+        }
+        uint64_t start = bytes;
+        bytes += line.size() + 1;
+        if (!line.empty() and line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        next_line++;
+        T *row = &values[rows * width];
+        if (row_num == true)
+        {
+            row[0] = (T)next_line;
+            row++;
+        }
+        csv_detail::row_status status = source->read_rows(line, row);
+        if (status.valid or source->keep_row(status, next_line, source->NChar + start, source->errors, source->NErrors))
+        {
+            rows++;
+        }
+    }
+    if (input.failed())
+    {
+        throw typename csv::input_failed();
+    }
+    current.first_row = next_row;
+    current.rows = rows;
+    next_row += rows;
+    if (rows > 0)
+    {
+        source->stage_progress(bytes, next_row);
+    }
+    else
+    {
+        source->stage_end(bytes, next_row);
+    }
+    return rows > 0;
+}
+
+// ==========================
+// End of CSV Implementation
 // ==========================
\ No newline at end of file
@@ -0,0 +1,506 @@
+/**
+ * @file WriteCSV.hpp
+ * @author Ghazal Khalili (khalili.ghazal.97@gmail.com)
+ * @brief
+ * @version 1.1
+ * @date 2021-12-30
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <charconv>
+#include <type_traits>
+#include <limits>
+#include "ReadCSV.hpp"
+
+using namespace std;
+
+/**
+ * @brief Options given to the csv_writer constructor.
+ */
+struct csv_write_options
+{
+    /**
+     * @brief The delimiter of the columns; its quote character (or '"' if it has none) quotes the column names
+     * that contain the delimiter, a quote or a line break. The values are numbers, so they are never quoted.
+     */
+    csv_dialect dialect;
+    /**
+     * @brief Number of threads formatting the rows (0 means all hardware threads).
+     * The rows are formatted in blocks of about 1 MB, which are written in order.
+     */
+    uint64_t threads = 1;
+    /**
+     * @brief If true, the first column numbers the rows from 1, like the row numbers of csv::read_data(true).
+     */
+    bool row_numbers = false;
+    /**
+     * @brief The name of the row number column in the header.
+     */
+    string row_number_name = "row";
+    /**
+     * @brief If true, the file is compressed with gzip (the program must be built with READCSV_USE_ZLIB and -lz).
+     */
+    bool gzip = false;
+};
+
+namespace csv_detail
+{
+    /**
+     * @brief Writes bytes to a file, compressing them with gzip if asked to.
+     */
+    class file_writer
+    {
+    public:
+        /**
+         * @param file_name Name of the file (it is replaced if it exists).
+         * @param gzip Whether the file is compressed (only with READCSV_USE_ZLIB; otherwise the file is not opened).
+         */
+        file_writer(const string &, const bool &);
+        ~file_writer();
+        file_writer(const file_writer &) = delete;
+        file_writer &operator=(const file_writer &) = delete;
+
+        bool is_open() const { return open; }
+
+        /**
+         * @brief Writes n bytes.
+         * @return False if they could not be written.
+         */
+        bool write(const char *, const uint64_t &);
+
+        /**
+         * @brief Ends the compressed stream and closes the file.
+         * @return False if the end of the file could not be written.
+         */
+        bool finish();
+
+    private:
+        ofstream output;
+        bool open = false;
+        bool compress = false;
+#ifdef READCSV_USE_ZLIB
+        z_stream stream = {};
+        vector<char> compressed;
+
+        /**
+         * @brief Compresses the input of the stream, and writes what comes out.
+         */
+        bool deflate_input(const int &flush);
+#endif
+    };
+
+    inline file_writer::file_writer(const string &file_name, const bool &gzip)
+        : compress(gzip)
+    {
+#ifndef READCSV_USE_ZLIB
+        if (compress)
+        {
+            return; // Without zlib, an existing file is left as it is
+        }
+#endif
+        output.open(file_name, ios::binary | ios::trunc);
+        open = output.is_open();
+#ifdef READCSV_USE_ZLIB
+        if (open and compress)
+        {
+            // 16 + MAX_WBITS asks for a gzip header and trailer instead of a zlib one
+            open = (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+            compressed.resize(1 << 20);
+        }
+#endif
+    }
+
+    inline file_writer::~file_writer()
+    {
+#ifdef READCSV_USE_ZLIB
+        if (compress)
+            deflateEnd(&stream);
+#endif
+    }
+
+#ifdef READCSV_USE_ZLIB
+    inline bool file_writer::deflate_input(const int &flush)
+    {
+        int result = Z_OK;
+        do
+        {
+            stream.next_out = (Bytef *)compressed.data();
+            stream.avail_out = (uInt)compressed.size();
+            result = deflate(&stream, flush);
+            if (result == Z_STREAM_ERROR)
+                return false;
+            output.write(compressed.data(), (streamsize)(compressed.size() - stream.avail_out));
+        } while (stream.avail_out == 0 or (flush == Z_FINISH and result != Z_STREAM_END));
+        return output.good();
+    }
+#endif
+
+    inline bool file_writer::write(const char *first, const uint64_t &n)
+    {
+#ifdef READCSV_USE_ZLIB
+        if (compress)
+        {
+            // avail_in is 32 bits wide, so large writes are given in parts
+            for (uint64_t done = 0; done < n;)
+            {
+                uint64_t part = min<uint64_t>(n - done, 1 << 30);
+                stream.next_in = (Bytef *)(first + done);
+                stream.avail_in = (uInt)part;
+                if (!deflate_input(Z_NO_FLUSH))
+                    return false;
+                done += part;
+            }
+            return true;
+        }
+#endif
+        output.write(first, (streamsize)n);
+        return output.good();
+    }
+
+    inline bool file_writer::finish()
+    {
+#ifdef READCSV_USE_ZLIB
+        if (compress)
+        {
+            stream.next_in = nullptr;
+            stream.avail_in = 0;
+            if (!deflate_input(Z_FINISH))
+                return false;
+        }
+#endif
+        output.close();
+        return !output.fail();
+    }
+} // namespace csv_detail
+
+/**
+ * @brief Writes data sets to a csv file: a header line, and then the rows of matrices.
+ * The numbers are formatted with to_chars (floating-point numbers in the shortest fixed notation that reads back
+ * to the same value; NaN and infinity are written as "nan" and "inf", which csv reads as invalid numbers),
+ * into large buffers that are formatted in parallel and written in order.
+ * @tparam T type of the values.
+ */
+template <typename T>
+class csv_writer
+{
+public:
+    /**
+     * @brief Creates the file and writes its header.
+     * It might throw two exceptions.
+     * @param file_name Name of the file (it is replaced if it exists).
+     * @param column_names Names of the columns of the data sets (without the row number column).
+     * @param options Options (see csv_write_options).
+     */
+    csv_writer(const string &, const vector<string> &, const csv_write_options & = csv_write_options());
+
+    /**
+     * @brief Closes the file if close() was not called (the errors are then ignored).
+     */
+    ~csv_writer();
+
+    csv_writer(const csv_writer &) = delete;
+    csv_writer &operator=(const csv_writer &) = delete;
+
+    /**
+     * @brief Writes the rows of a data set after the rows written before.
+     * It might throw two exceptions.
+     * @param data The data set, with one column for every column name.
+     */
+    template <typename Alloc>
+    void write(const matrix<T, Alloc> &);
+
+    /**
+     * @brief Writes the rows of a column-major data set after the rows written before.
+     * It might throw two exceptions.
+     * @param data The data set, with one column for every column name.
+     */
+    template <typename Alloc>
+    void write(const column_matrix<T, Alloc> &);
+
+    /**
+     * @brief Ends the file (and the compressed stream). No rows can be written afterwards.
+     * It might throw an exception.
+     */
+    void close();
+
+    /**
+     * @brief Gets the number of rows written.
+     * @return uint64_t Number of rows.
+     */
+    uint64_t get_NRows() const;
+
+    /**
+     * @brief Exception to be thrown if the file cannot be created.
+     * @param file Name of the file (given in the message).
+     */
+    class file_notcreated : public invalid_argument
+    {
+    public:
+        file_notcreated(const string &file) : invalid_argument("\nFile \"" + file + "\": Cannot create a file with the given name!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if writing the file encounters an error (or the file is closed).
+     */
+    class output_failed : public invalid_argument
+    {
+    public:
+        output_failed() : invalid_argument("\nWriting the file encountered an error!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if a data set does not have one column for every column name.
+     */
+    class column_invalid : public out_of_range
+    {
+    public:
+        column_invalid() : out_of_range("\nThe data set must have one column for every column name!\n\n"){};
+    };
+
+    /**
+     * @brief Exception to be thrown if gzip output is asked for, but the program is built without READCSV_USE_ZLIB.
+     * @param file Name of the file (given in the message).
+     */
+    class compression_unsupported : public invalid_argument
+    {
+    public:
+        compression_unsupported(const string &file) : invalid_argument("\nFile \"" + file + "\": Build with READCSV_USE_ZLIB to write gzip files!\n\n"){};
+    };
+
+private:
+    /**
+     * @brief Formats the rows in blocks on the threads, and writes the blocks in order.
+     * @param rows Number of rows.
+     * @param cols Number of columns.
+     * @param value Gives the value at (row, col).
+     */
+    template <typename F>
+    void write_rows(const uint64_t &, const uint64_t &, const F &);
+
+    /**
+     * @brief The type given to to_chars (other types than numbers are converted to double).
+     */
+    using number_type = conditional_t<(is_integral_v<T> and !is_same_v<T, bool>) or is_floating_point_v<T>, T, double>;
+
+    /**
+     * @brief Writes a value with to_chars, in fixed notation as the reader does not accept exponents.
+     * @param first Where it is written (there must be room for max_chars characters).
+     * @return char* The end of the value.
+     */
+    static char *format(char *, const T &);
+
+    /**
+     * @brief Room for a value (or a row number) and its delimiter.
+     * The longest fixed notation is that of the smallest numbers: "-0.", the zeros, and the significant digits.
+     */
+    static constexpr uint64_t max_chars = is_floating_point_v<number_type>
+                                              ? (uint64_t)(numeric_limits<number_type>::max_digits10 - numeric_limits<number_type>::min_exponent10 + 16)
+                                              : 32;
+
+    string datafile;
+    csv_write_options options;
+    csv_detail::file_writer output;
+    uint64_t NCols = 0;
+    uint64_t NRows = 0;
+    bool closed = false;
+    /**
+     * @brief A buffer for every thread, reused from one block to the next.
+     */
+    vector<vector<char>> buffers;
+};
+
+// ==============
+// Implementation
+// ==============
+
+template <typename T>
+csv_writer<T>::csv_writer(const string &_file_name, const vector<string> &column_names, const csv_write_options &_options)
+    : datafile(_file_name), options(_options), output(_file_name, _options.gzip), NCols(column_names.size())
+{
+#ifndef READCSV_USE_ZLIB
+    if (options.gzip == true)
+    {
+        throw typename csv_writer::compression_unsupported(datafile);
+    }
+#endif
+    if (!output.is_open())
+    {
+        throw typename csv_writer::file_notcreated(datafile);
+    }
+
+    // The header, with the names quoted where they would not be read back as one column
+    char delimiter = options.dialect.delimiter;
+    char quote = (options.dialect.quote == '\0') ? '"' : options.dialect.quote;
+    string header;
+    auto add_name = [&](const string &name)
+    {
+        if (!header.empty())
+        {
+            header += delimiter;
+        }
+        if (name.find_first_of(string{delimiter, quote, '\n', '\r'}) == string::npos)
+        {
+            header += name;
+            return;
+        }
+        header += quote;
+        for (const char &c : name)
+        {
+            header += c;
+            if (c == quote)
+            {
+                header += quote; // Two quotes in a row stand for one
+            }
+        }
+        header += quote;
+    };
+    if (options.row_numbers == true)
+    {
+        add_name(options.row_number_name);
+    }
+    for (const string &name : column_names)
+    {
+        add_name(name);
+    }
+    header += '\n';
+    if (!output.write(header.data(), header.size()))
+    {
+        throw typename csv_writer::output_failed();
+    }
+}
+
+template <typename T>
+csv_writer<T>::~csv_writer()
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+    }
+}
+
+template <typename T>
+template <typename Alloc>
+void csv_writer<T>::write(const matrix<T, Alloc> &data)
+{
+    const T *elements = data.data();
+    uint64_t cols = data.get_cols();
+    write_rows(data.get_rows(), cols, [&](const uint64_t &i, const uint64_t &j)
+               { return elements[i * cols + j]; });
+}
+
+template <typename T>
+template <typename Alloc>
+void csv_writer<T>::write(const column_matrix<T, Alloc> &data)
+{
+    write_rows(data.get_rows(), data.get_cols(), [&](const uint64_t &i, const uint64_t &j)
+               { return data(i, j); });
+}
+
+template <typename T>
+template <typename F>
+void csv_writer<T>::write_rows(const uint64_t &rows, const uint64_t &cols, const F &value)
+{
+    if (cols != NCols)
+    {
+        throw typename csv_writer::column_invalid();
+    }
+    if (closed == true)
+    {
+        throw typename csv_writer::output_failed();
+    }
+    uint64_t NThreads = (options.threads == 0) ? max<uint64_t>(thread::hardware_concurrency(), 1) : options.threads;
+    // The blocks are sized for values of about 24 characters, and their buffers grow if the values are longer
+    uint64_t block_rows = max<uint64_t>((1 << 20) / ((cols + 1) * 24), 1);
+    buffers.resize(NThreads);
+    vector<uint64_t> used(NThreads, 0);
+    char delimiter = options.dialect.delimiter;
+
+    for (uint64_t first = 0; first < rows; first += NThreads * block_rows)
+    {
+        uint64_t NBlocks = min(NThreads, (rows - first + block_rows - 1) / block_rows);
+        csv_detail::run_in_parallel(NBlocks, [&](uint64_t k)
+                                    {
+            uint64_t begin = first + k * block_rows;
+            uint64_t end = min(begin + block_rows, rows);
+            vector<char> &buffer = buffers[k];
+            char *next = buffer.data();
+            for (uint64_t i = begin; i < end; i++)
+            {
+                // Room for the longest row
+                uint64_t length = (uint64_t)(next - buffer.data());
+                if (buffer.size() - length < (cols + 1) * max_chars)
+                {
+                    buffer.resize(max(2 * buffer.size(), length + (cols + 1) * max_chars));
+                    next = buffer.data() + length;
+                }
+                if (options.row_numbers == true)
+                {
+                    next = to_chars(next, next + max_chars, NRows + i + 1).ptr;
+                    *next++ = delimiter;
+                }
+                for (uint64_t j = 0; j < cols; j++)
+                {
+                    next = format(next, value(i, j));
+                    *next++ = delimiter;
+                }
+                next[-1] = '\n'; // In place of the last delimiter
+            }
+            used[k] = (uint64_t)(next - buffer.data()); });
+        for (uint64_t k = 0; k < NBlocks; k++)
+        {
+            if (!output.write(buffers[k].data(), used[k]))
+            {
+                throw typename csv_writer::output_failed();
+            }
+        }
+    }
+    NRows += rows;
+}
+
+template <typename T>
+char *csv_writer<T>::format(char *first, const T &value)
+{
+    if constexpr (is_floating_point_v<number_type>)
+    {
+        // The shortest digits that read back to the same value
+        return to_chars(first, first + max_chars - 1, (number_type)value, chars_format::fixed).ptr;
+    }
+    else
+    {
+        return to_chars(first, first + max_chars - 1, value).ptr;
+    }
+}
+
+template <typename T>
+void csv_writer<T>::close()
+{
+    if (closed == true)
+    {
+        return;
+    }
+    closed = true;
+    if (!output.finish())
+    {
+        throw typename csv_writer::output_failed();
+    }
+}
+
+template <typename T>
+inline uint64_t csv_writer<T>::get_NRows() const
+{
+    return NRows;
+}
@@ -0,0 +1,343 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <filesystem>
+#include "ReadCSV.hpp"
+#include "WriteCSV.hpp"
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+/**
+ * @brief Shape of a generated csv file.
+ */
+struct data_shape
+{
+    string name;
+    uint64_t cols;
+    uint64_t max_digits; // The integer part of a value has 1 to max_digits digits
+    uint64_t decimals;   // Number of digits after the decimal point (0 for integers)
+};
+
+/**
+ * @brief Writes a csv file of about the given size with random values.
+ * The values only depend on the shape and the size, so every run reads the same file.
+ * @param file_name Name of the file.
+ * @param shape Number of columns and width of the values.
+ * @param bytes Approximate size of the file.
+ * @return uint64_t Number of rows written.
+ */
+uint64_t generate(const string &file_name, const data_shape &shape, const uint64_t &bytes)
+{
+    ofstream output(file_name, ios::binary);
+    mt19937_64 random(shape.cols * 1000003 + shape.max_digits * 101 + shape.decimals);
+    string text;
+    for (uint64_t j = 0; j < shape.cols; j++)
+    {
+        text += (j == 0 ? "" : ",") + ("c" + to_string(j));
+    }
+    text += '\n';
+    uint64_t written = 0;
+    uint64_t rows = 0;
+    char number[64];
+    while (written + text.size() < bytes)
+    {
+        for (uint64_t j = 0; j < shape.cols; j++)
+        {
+            uint64_t digits = 1 + random() % shape.max_digits;
+            uint64_t limit = 1;
+            for (uint64_t d = 0; d < digits; d++)
+            {
+                limit *= 10;
+            }
+            char *end = number;
+            if (random() % 4 == 0)
+            {
+                *end++ = '-';
+            }
+            end = to_chars(end, number + sizeof(number), random() % limit).ptr;
+            if (shape.decimals > 0)
+            {
+                *end++ = '.';
+                for (uint64_t d = 0; d < shape.decimals; d++)
+                {
+                    *end++ = (char)('0' + random() % 10);
+                }
+            }
+            if (j > 0)
+            {
+                text += ',';
+            }
+            text.append(number, end);
+        }
+        text += '\n';
+        rows++;
+        if (text.size() > (1 << 20))
+        {
+            output.write(text.data(), (streamsize)text.size());
+            written += text.size();
+            text.clear();
+        }
+    }
+    output.write(text.data(), (streamsize)text.size());
+    return rows;
+}
+
+/**
+ * @brief Gets a memory field of /proc/self/status (such as "VmRSS:") in MB (0 where it is not available).
+ */
+double status_mb(const string &field)
+{
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line))
+    {
+        if (line.compare(0, field.size(), field) == 0)
+        {
+            return stod(line.substr(field.size())) / 1024.0; // In KB
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Measures how far the resident memory of the process rises above its level when it is created.
+ * The peak of the process is reset first (through /proc/self/clear_refs, on Linux), so that each benchmark
+ * reports its own peak rather than the largest one so far. Where it cannot be reset, the growth is 0.
+ */
+class memory_growth
+{
+public:
+    memory_growth()
+    {
+#ifdef __GLIBC__
+        malloc_trim(0); // Returns the memory freed by earlier benchmarks, which would be reused without growing
+#endif
+        ofstream clear_refs("/proc/self/clear_refs");
+        clear_refs << "5"; // Resets the peak resident memory to the current one
+        clear_refs.close();
+        resettable = !clear_refs.fail();
+        baseline = status_mb("VmRSS:");
+    }
+
+    /**
+     * @brief Gets the peak resident memory since the creation, above the memory at the creation, in MB.
+     */
+    double peak_mb() const
+    {
+        return resettable ? max(status_mb("VmHWM:") - baseline, 0.0) : 0;
+    }
+
+private:
+    bool resettable = false;
+    double baseline = 0;
+};
+
+/**
+ * @brief Runs a benchmark a few times, and reports the fastest run
+ * and how far the resident memory rose above its level before the first run.
+ * @param report Where the results are written.
+ * @param name Name of the benchmark.
+ * @param bytes Bytes processed by one run (0 if it does not apply).
+ * @param rows Rows processed by one run (0 if it does not apply).
+ * @param repeats Number of runs.
+ * @param body The benchmark.
+ * @return double The time of the fastest run in seconds.
+ */
+double run(ostream &report, const string &name, const uint64_t &bytes, const uint64_t &rows, const uint64_t &repeats, const function<void()> &body)
+{
+    double best = numeric_limits<double>::max();
+    memory_growth memory;
+    for (uint64_t r = 0; r < repeats; r++)
+    {
+        auto start = chrono::steady_clock::now();
+        body();
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    report << left << setw(44) << name << right << fixed << setprecision(2) << setw(10) << best * 1000 << " ms";
+    if (bytes > 0)
+    {
+        report << setw(10) << (double)bytes / (1024.0 * 1024.0) / best << " MB/s";
+    }
+    else
+    {
+        report << setw(15) << "";
+    }
+    if (rows > 0)
+    {
+        report << setw(10) << (double)rows / best / 1e6 << " M rows/s";
+    }
+    else
+    {
+        report << setw(19) << "";
+    }
+    report << setw(10) << memory.peak_mb() << " MB peak growth\n";
+    return best;
+}
+
+/**
+ * @brief Keeps the compiler from dropping a computation whose result is not used.
+ */
+template <typename V>
+void keep(const V &value)
+{
+    static volatile V sink;
+    sink = value;
+    (void)sink;
+}
+
+int main(int argc, char *argv[])
+{
+    /**
+     * @mainpage
+     * Benchmarks of the 'ReadCSV', 'WriteCSV' and 'matrix' headers.
+     * Usage: benchmark [MB per file (default 64)] [directory of the generated files (default: current)]
+     * The files are generated once (with the same values on every run) and reused afterwards.
+     */
+    uint64_t megabytes = (argc > 1) ? stoull(argv[1]) : 64;
+    filesystem::path directory = (argc > 2) ? argv[2] : ".";
+    uint64_t repeats = 3;
+
+    ostream &report = cout;
+
+    const vector<data_shape> shapes = {
+        {"tall", 5, 4, 2},    // Few short columns: many rows per MB
+        {"wide", 200, 6, 3},  // Many columns: long lines
+        {"mixed", 20, 12, 0}, // Integers from 1 to 12 digits
+    };
+    for (const data_shape &shape : shapes)
+    {
+        string file_name = (directory / ("bench_" + shape.name + "_" + to_string(megabytes) + "MB.csv")).string();
+        if (!filesystem::exists(file_name))
+        {
+            report << "Generating " << file_name << "\n";
+            generate(file_name, shape, megabytes << 20);
+        }
+        uint64_t bytes = filesystem::file_size(file_name);
+        uint64_t rows = csv<double>(file_name).get_NRows();
+        report << "\n"
+               << shape.name << ": " << rows << " rows x " << shape.cols << " columns, " << bytes / (1024.0 * 1024.0) << " MB\n";
+
+        try
+        {
+            run(report, "constructor (row count)", bytes, rows, repeats, [&]
+                { csv<double> data(file_name); keep(data.get_NRows()); });
+            csv<double> data(file_name);
+            run(report, "read_data(false)", bytes, rows, repeats, [&]
+                { keep(data.read_data(false).get_rows()); });
+            run(report, "read_data(true)", bytes, rows, repeats, [&]
+                { keep(data.read_data(true).get_rows()); });
+            run(report, "read_columns(false)", bytes, rows, repeats, [&]
+                { keep(data.read_columns(false).get_rows()); });
+            run(report, "batches(4096) (bounded memory)", bytes, rows, repeats, [&]
+                {
+                    uint64_t n = 0;
+                    for (const auto &batch : data.batches(4096, false))
+                        n += batch.get_rows();
+                    keep(n); });
+            csv_options mapped_options;
+            mapped_options.mode = load_mode::mapped;
+            csv_options parallel_options = mapped_options;
+            parallel_options.threads = 0;
+            csv_options prefetch_options;
+            prefetch_options.prefetch = 4;
+            // A single pass over the mapped file, which is mostly the parsing of the rows (read_rows)
+            run(report, "mapped: constructor + read_data(false)", bytes, rows, repeats, [&]
+                { csv<double> mapped(file_name, mapped_options); keep(mapped.read_data(false).get_rows()); });
+            run(report, "mapped, all threads: read_data(false)", bytes, rows, repeats, [&]
+                { csv<double> parallel(file_name, parallel_options); keep(parallel.read_data(false).get_rows()); });
+            run(report, "stream, prefetch 4: read_data(false)", bytes, rows, repeats, [&]
+                { csv<double> prefetched(file_name, prefetch_options); keep(prefetched.read_data(false).get_rows()); });
+            if (shape.decimals == 0)
+            {
+                run(report, "csv<int64_t>: read_data(false)", bytes, rows, repeats, [&]
+                    { csv<int64_t> integers(file_name); keep(integers.read_data(false).get_rows()); });
+                run(report, "read_table (int64 columns)", bytes, rows, repeats, [&]
+                    { keep(data.read_table(vector<column_type>(shape.cols, column_type::int64)).get_rows()); });
+            }
+
+            // Writing the values back: ofstream << with round-trip precision against csv_writer
+            matrix<double> values = data.read_data(false);
+            vector<string> names = data.get_column_names();
+            string output_name = file_name + ".out";
+            run(report, "write: ofstream << (precision 17)", bytes, rows, repeats, [&]
+                {
+                    ofstream output(output_name);
+                    output << setprecision(17);
+                    for (uint64_t i = 0; i < values.get_rows(); i++)
+                        for (uint64_t j = 0; j < values.get_cols(); j++)
+                            output << values(i, j) << (j + 1 < values.get_cols() ? ',' : '\n');
+                    keep(output.good()); });
+            run(report, "write: csv_writer", bytes, rows, repeats, [&]
+                { csv_writer<double> writer(output_name, names); writer.write(values); writer.close(); });
+            csv_write_options write_options;
+            write_options.threads = 0;
+            run(report, "write: csv_writer, all threads", bytes, rows, repeats, [&]
+                { csv_writer<double> writer(output_name, names, write_options); writer.write(values); writer.close(); });
+            filesystem::remove(output_name);
+        }
+        catch (const exception &e)
+        {
+            report << e.what();
+            return -1;
+        }
+    }
+
+    // Matrix operators
+    report << "\nmatrix<double>\n";
+    const uint64_t n = 2048;
+    matrix<double> A(n, n), B(n, n), C(n, n);
+    for (uint64_t i = 0; i < n * n; i++)
+    {
+        A.data()[i] = (double)(i % 97) * 0.5;
+        B.data()[i] = (double)(i % 89) * 0.25;
+        C.data()[i] = (double)(i % 83);
+    }
+    uint64_t matrix_bytes = n * n * sizeof(double);
+    run(report, "A + B (2048 x 2048)", 3 * matrix_bytes, 0, repeats, [&]
+        { matrix<double> D = A + B; keep(D(0, 0)); });
+    run(report, "A + B - 2 * C, fused (2048 x 2048)", 4 * matrix_bytes, 0, repeats, [&]
+        { matrix<double> D = A + B - 2.0 * C; keep(D(0, 0)); });
+    run(report, "A += B (2048 x 2048)", 2 * matrix_bytes, 0, repeats, [&]
+        { A += B; keep(A(0, 0)); });
+
+    const uint64_t m = 512;
+    matrix<double> P(m, m), Q(m, m);
+    for (uint64_t i = 0; i < m * m; i++)
+    {
+        P.data()[i] = (double)(i % 13) - 6;
+        Q.data()[i] = (double)(i % 7) * 0.5;
+    }
+    double flops = 2.0 * (double)(m * m * m);
+    double tiled = run(report, "A * B (512 x 512)", 0, 0, repeats, [&]
+                       { matrix<double> R = P * Q; keep(R(0, 0)); });
+    matrix<double> tiled_result = P * Q;
+    matrix<double> naive_result(m, m);
+    double naive = run(report, "A * B, naive triple loop (512 x 512)", 0, 0, 1, [&]
+                       {
+        for (uint64_t i = 0; i < m; i++)
+            for (uint64_t j = 0; j < m; j++)
+            {
+                double sum = 0;
+                for (uint64_t k = 0; k < m; k++)
+                    sum += P(i, k) * Q(k, j);
+                naive_result(i, j) = sum;
+            }
+        keep(naive_result(0, 0)); });
+    report << "A * B: " << flops / tiled / 1e9 << " GFLOP/s (" << naive / tiled << " times the naive loop)\n";
+    // Both sum over k in the same order (and the values are exact in binary), so the results must be equal
+    for (uint64_t i = 0; i < m * m; i++)
+    {
+        if (tiled_result.data()[i] != naive_result.data()[i])
+        {
+            report << "A * B differs from the naive loop at (" << i / m << ", " << i % m << "): "
+                   << tiled_result.data()[i] << " instead of " << naive_result.data()[i] << "\n";
+            return -1;
+        }
+    }
+}
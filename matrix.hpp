@@ -1,310 +1,1141 @@
-#include <initializer_list>
-#include <iostream>
-#include <stdexcept>
-#include <vector>
-using namespace std;
-
-// =========
-// Interface
-// =========
-
-template <typename T>
-class matrix
-{
-public:
-    // Constructor to create a zero matrix.
-    // First argument: number of rows.
-    // Second argument: number of columns.
-    matrix(const uint64_t &, const uint64_t &);
-
-    // Constructor to create a diagonal matrix from a vector.
-    // Argument: a vector containing the elements on the diagonal.
-    // Number of rows and columns is inferred automatically.
-    matrix(const vector<T> &);
-
-    // Constructor to create a diagonal matrix from an initializer_list.
-    // Argument: an initializer_list containing the elements on the diagonal.
-    // Number of rows and columns is inferred automatically.
-    matrix(const initializer_list<T> &);
-
-    // Constructor to create a matrix from a vector.
-    // First argument: number of rows.
-    // Second argument: number of columns.
-    // Third argument: a vector containing the elements in row-major order.
-    matrix(const uint64_t &, const uint64_t &, const vector<T> &);
-
-    // Constructor to create a matrix from an initializer_list.
-    // First argument: number of rows.
-    // Second argument: number of columns.
-    // Third argument: an initializer_list containing the elements in row-major order.
-    matrix(const uint64_t &, const uint64_t &, const initializer_list<T> &);
-
-    // Member function to obtain (but not modify) the number of rows in the matrix.
-    uint64_t get_rows() const;
-
-    // Member function to obtain (but not modify) the number of columns in the matrix.
-    uint64_t get_cols() const;
-
-    // Overloaded operator () to access matrix elements WITHOUT range checking.
-    // The indices start from 0: m(0, 1) would be the element at row 1, column 2.
-    // First version: allows modification of the element.
-    T &operator()(const uint64_t &, const uint64_t &);
-
-    // Overloaded operator () to access matrix elements WITHOUT range checking.
-    // The indices start from 0: m(0, 1) would be the element at row 1, column 2.
-    // Second version: does not allow modification of the element.
-    const T &operator()(const uint64_t &, const uint64_t &) const;
-
-    // Member function to access matrix elements WITH range checking (throws out_of_range via vector::at).
-    // The indices start from 0: m.at(0, 1) would be the element at row 1, column 2.
-    // First version: allows modification of the element.
-    T &at(const uint64_t &, const uint64_t &);
-
-    // Member function to access matrix elements WITH range checking (throws out_of_range via vector::at).
-    // The indices start from 0: m.at(0, 1) would be the element at row 1, column 2.
-    // Second version: does not allow modification of the element.
-    const T &at(const uint64_t &, const uint64_t &) const;
-
-    // Exception to be thrown if the number of rows or columns given to the constructor is zero.
-    class zero_size : public invalid_argument
-    {
-    public:
-        zero_size() : invalid_argument("Matrix cannot have zero rows or columns!"){};
-    };
-
-    // Exception to be thrown if the vector of elements provided to the constructor is of the wrong size.
-    class initializer_wrong_size : public invalid_argument
-    {
-    public:
-        initializer_wrong_size() : invalid_argument("Initializer does not have the expected number of elements!"){};
-    };
-
-    // Exception to be thrown if two matrices of different sizes are added or subtracted.
-    class incompatible_sizes_add : public invalid_argument
-    {
-    public:
-        incompatible_sizes_add() : invalid_argument("Cannot add or subtract two matrices of different dimensions!"){};
-    };
-
-    // Exception to be thrown if two matrices of incompatible sizes are multiplied.
-    class incompatible_sizes_multiply : public invalid_argument
-    {
-    public:
-        incompatible_sizes_multiply() : invalid_argument("Two matrices can only be multiplied if the number of columns in the first matrix is equal to the number of rows in the second matrix!"){};
-    };
-
-private:
-    // The number of rows.
-    uint64_t rows = 0;
-
-    // The number of columns.
-    uint64_t cols = 0;
-
-    // A vector storing the elements of the matrix in flattened (1-dimensional) form.
-    vector<T> elements;
-};
-
-// Overloaded binary operator << to easily print out a matrix to a stream.
-template <typename T>
-ostream &operator<<(ostream &, const matrix<T> &);
-
-// Overloaded binary operator + to add two matrices.
-template <typename T>
-matrix<T> operator+(const matrix<T> &, const matrix<T> &);
-
-// Overloaded binary operator += to add two matrices and assign the result to the first one.
-template <typename T>
-matrix<T> operator+=(matrix<T> &, const matrix<T> &);
-
-// Overloaded unary operator - to take the negative of a matrix.
-template <typename T>
-matrix<T> operator-(const matrix<T> &);
-
-// Overloaded binary operator - to subtract two matrices.
-template <typename T>
-matrix<T> operator-(const matrix<T> &, const matrix<T> &);
-
-// Overloaded binary operator -= to subtract two matrices and assign the result to the first one.
-template <typename T>
-matrix<T> operator-=(matrix<T> &, const matrix<T> &);
-
-// Overloaded binary operator * to multiply two matrices.
-template <typename T>
-matrix<T> operator*(const matrix<T> &, const matrix<T> &);
-
-// Overloaded binary operator * to multiply a scalar on the left and a matrix on the right.
-template <typename T>
-matrix<T> operator*(const T &, const matrix<T> &);
-
-// Overloaded binary operator * to multiply a matrix on the left and a scalar on the right.
-template <typename T>
-matrix<T> operator*(const matrix<T> &, const T &);
-
-// ==============
-// Implementation
-// ==============
-
-template <typename T>
-matrix<T>::matrix(const uint64_t &_rows, const uint64_t &_cols)
-    : rows(_rows), cols(_cols)
-{
-    if (rows == 0 or cols == 0)
-        throw zero_size();
-    elements = vector<T>(rows * cols);
-}
-
-template <typename T>
-matrix<T>::matrix(const vector<T> &_diagonal)
-    : rows(_diagonal.size()), cols(_diagonal.size())
-{
-    if (rows == 0)
-        throw zero_size();
-    elements = vector<T>(rows * cols);
-    for (uint64_t i = 0; i < rows; i++)
-        elements[(cols * i) + i] = _diagonal[i];
-}
-
-template <typename T>
-matrix<T>::matrix(const initializer_list<T> &_diagonal)
-    : matrix(vector<T>(_diagonal)) {}
-
-template <typename T>
-matrix<T>::matrix(const uint64_t &_rows, const uint64_t &_cols, const vector<T> &_elements)
-    : rows(_rows), cols(_cols), elements(_elements)
-{
-    if (rows == 0 or cols == 0)
-        throw zero_size();
-    if (_elements.size() != rows * cols)
-        throw initializer_wrong_size();
-}
-
-template <typename T>
-matrix<T>::matrix(const uint64_t &_rows, const uint64_t &_cols, const initializer_list<T> &_elements)
-    : matrix(_rows, _cols, vector<T>(_elements)) {}
-
-template <typename T>
-uint64_t matrix<T>::get_rows() const
-{
-    return rows;
-}
-
-template <typename T>
-uint64_t matrix<T>::get_cols() const
-{
-    return cols;
-}
-
-template <typename T>
-T &matrix<T>::operator()(const uint64_t &row, const uint64_t &col)
-{
-    return elements[(cols * row) + col];
-}
-
-template <typename T>
-const T &matrix<T>::operator()(const uint64_t &row, const uint64_t &col) const
-{
-    return elements[(cols * row) + col];
-}
-
-template <typename T>
-T &matrix<T>::at(const uint64_t &row, const uint64_t &col)
-{
-    return elements.at((cols * row) + col);
-}
-
-template <typename T>
-const T &matrix<T>::at(const uint64_t &row, const uint64_t &col) const
-{
-    return elements.at((cols * row) + col);
-}
-
-template <typename T>
-ostream &operator<<(ostream &out, const matrix<T> &m)
-{
-    out << '\n';
-    for (uint64_t i = 0; i < m.get_rows(); i++)
-    {
-        out << "( ";
-        for (uint64_t j = 0; j < m.get_cols(); j++)
-            out << m(i, j) << '\t';
-        out << ")\n";
-    }
-    return out;
-}
-
-template <typename T>
-matrix<T> operator+(const matrix<T> &a, const matrix<T> &b)
-{
-    if ((a.get_rows() != b.get_rows()) or (a.get_cols() != b.get_cols()))
-        throw typename matrix<T>::incompatible_sizes_add();
-    matrix<T> c(a.get_rows(), a.get_cols());
-    for (uint64_t i = 0; i < a.get_rows(); i++)
-        for (uint64_t j = 0; j < a.get_cols(); j++)
-            c(i, j) = a(i, j) + b(i, j);
-    return c;
-}
-
-template <typename T>
-matrix<T> operator+=(matrix<T> &a, const matrix<T> &b)
-{
-    a = a + b;
-    return a;
-}
-
-template <typename T>
-matrix<T> operator-(const matrix<T> &m)
-{
-    matrix<T> c(m.get_rows(), m.get_cols());
-    for (uint64_t i = 0; i < m.get_rows(); i++)
-        for (uint64_t j = 0; j < m.get_cols(); j++)
-            c(i, j) = -m(i, j);
-    return c;
-}
-
-template <typename T>
-matrix<T> operator-(const matrix<T> &a, const matrix<T> &b)
-{
-    if ((a.get_rows() != b.get_rows()) or (a.get_cols() != b.get_cols()))
-        throw typename matrix<T>::incompatible_sizes_add();
-    matrix<T> c(a.get_rows(), a.get_cols());
-    for (uint64_t i = 0; i < a.get_rows(); i++)
-        for (uint64_t j = 0; j < a.get_cols(); j++)
-            c(i, j) = a(i, j) - b(i, j);
-    return c;
-}
-
-template <typename T>
-matrix<T> operator-=(matrix<T> &a, const matrix<T> &b)
-{
-    a = a - b;
-    return a;
-}
-
-template <typename T>
-matrix<T> operator*(const matrix<T> &a, const matrix<T> &b)
-{
-    if (a.get_cols() != b.get_rows())
-        throw typename matrix<T>::incompatible_sizes_multiply();
-    matrix<T> c(a.get_rows(), b.get_cols());
-    for (uint64_t i = 0; i < a.get_rows(); i++)
-        for (uint64_t j = 0; j < b.get_cols(); j++)
-            for (uint64_t k = 0; k < a.get_cols(); k++)
-                c(i, j) += a(i, k) * b(k, j);
-    return c;
-}
-
-template <typename T>
-matrix<T> operator*(const T &s, const matrix<T> &m)
-{
-    matrix<T> c(m.get_rows(), m.get_cols());
-    for (uint64_t i = 0; i < m.get_rows(); i++)
-        for (uint64_t j = 0; j < m.get_cols(); j++)
-            c(i, j) = s * m(i, j);
-    return c;
-}
-
-template <typename T>
-matrix<T> operator*(const matrix<T> &m, const T &s)
-{
-    return s * m;
-}
\ No newline at end of file
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+using namespace std;
+
+// =========
+// Interface
+// =========
+
+// An allocator returning memory aligned to Alignment bytes (64 by default: a cache line, and enough for any SIMD load).
+// With HugePages, allocations of 2 MB or more are aligned to 2 MB and (on Linux) marked for transparent huge pages,
+// which reduces page faults and TLB misses for large data sets.
+template <typename T, size_t Alignment = 64, bool HugePages = false>
+class aligned_allocator
+{
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = aligned_allocator<U, Alignment, HugePages>;
+    };
+
+    aligned_allocator() = default;
+
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U, Alignment, HugePages> &) {}
+
+    // Member function to allocate memory for n elements.
+    T *allocate(const size_t &);
+
+    // Member function to free memory allocated for n elements.
+    void deallocate(T *, const size_t &);
+
+    template <typename U>
+    bool operator==(const aligned_allocator<U, Alignment, HugePages> &) const { return true; }
+
+private:
+    // The size of a huge page.
+    static constexpr size_t huge_page = (size_t)1 << 21;
+
+    // Member function to obtain the alignment used for n elements.
+    static size_t alignment(const size_t &);
+};
+
+template <typename T, typename Alloc = allocator<T>>
+class matrix;
+
+// Exception to be thrown if two matrices (or expressions) of different sizes are added or subtracted.
+// It does not depend on the type of the elements or on the allocator, so one handler catches it for every matrix.
+class matrix_incompatible_sizes_add : public invalid_argument
+{
+public:
+    matrix_incompatible_sizes_add() : invalid_argument("Cannot add or subtract two matrices of different dimensions!"){};
+};
+
+// A matrix, or a lazy element-wise expression of matrices such as 2.0 * (a + b) - c.
+// Expressions are evaluated in a single loop when they are assigned to a matrix.
+// Expressions keep the matrices in them by reference (and nested expressions by value), so an expression must not
+// outlive its matrices: auto e = a + f(); dangles once the matrix returned by f() is destroyed at the end of the statement.
+// Assign the expression to a matrix instead (matrix<double> e = a + f();), or use it within the same statement.
+template <typename E>
+concept matrix_expression = requires(const E &e, const uint64_t &i) {
+    typename E::value_type;
+    { e.get_rows() } -> convertible_to<uint64_t>;
+    { e.get_cols() } -> convertible_to<uint64_t>;
+    { e.element(i) } -> convertible_to<typename E::value_type>;
+};
+
+// Whether a matrix (or expression) has an allocator: matrices do, and so do expressions with a matrix in them.
+// Views and expressions of views only do not.
+template <typename E>
+concept allocator_expression = requires(const E &e) { e.get_allocator(); };
+
+// Whether E is a matrix (rather than an expression).
+template <typename E>
+inline constexpr bool is_matrix_v = false;
+
+template <typename T, typename Alloc>
+inline constexpr bool is_matrix_v<matrix<T, Alloc>> = true;
+
+template <typename T>
+class matrix_view;
+
+template <typename T>
+class column_view;
+
+template <typename T, typename Alloc>
+class matrix
+{
+public:
+    // The type of the elements.
+    using value_type = T;
+
+    // Constructor to create a zero matrix.
+    // First argument: number of rows.
+    // Second argument: number of columns.
+    matrix(const uint64_t &, const uint64_t &);
+
+    // Constructor to create a zero matrix whose storage comes from the given allocator
+    // (for example, a pmr::polymorphic_allocator drawing from a per-job arena).
+    // First argument: number of rows.
+    // Second argument: number of columns.
+    // Third argument: the allocator.
+    matrix(const uint64_t &, const uint64_t &, const Alloc &);
+
+    // Constructor to create a diagonal matrix from a vector.
+    // Argument: a vector containing the elements on the diagonal.
+    // Number of rows and columns is inferred automatically.
+    matrix(const vector<T> &);
+
+    // Constructor to create a diagonal matrix from an initializer_list.
+    // Argument: an initializer_list containing the elements on the diagonal.
+    // Number of rows and columns is inferred automatically.
+    matrix(const initializer_list<T> &);
+
+    // Constructor to create a matrix from a vector.
+    // First argument: number of rows.
+    // Second argument: number of columns.
+    // Third argument: a vector containing the elements in row-major order.
+    matrix(const uint64_t &, const uint64_t &, const vector<T> &);
+
+    // Constructor to create a matrix from a vector, taking over its storage instead of copying it.
+    // First argument: number of rows.
+    // Second argument: number of columns.
+    // Third argument: an rvalue vector containing the elements in row-major order.
+    matrix(const uint64_t &, const uint64_t &, vector<T, Alloc> &&);
+
+    // Constructor to create a matrix from an initializer_list.
+    // First argument: number of rows.
+    // Second argument: number of columns.
+    // Third argument: an initializer_list containing the elements in row-major order.
+    matrix(const uint64_t &, const uint64_t &, const initializer_list<T> &);
+
+    // Constructor to evaluate an element-wise expression, such as a + b, in a single loop.
+    // The storage comes from a copy of the allocator of the leftmost matrix in the expression if it converts to Alloc,
+    // and from a default Alloc otherwise.
+    // Argument: the expression (with at least one row and one column).
+    template <matrix_expression E>
+        requires(!is_matrix_v<E>)
+    matrix(const E &);
+
+    // Constructor to evaluate an element-wise expression, such as a + b, in a single loop, into storage from the given allocator.
+    // First argument: the expression (with at least one row and one column).
+    // Second argument: the allocator.
+    template <matrix_expression E>
+        requires(!is_matrix_v<E>)
+    matrix(const E &, const Alloc &);
+
+    // Overloaded assignment operator to evaluate an element-wise expression into this matrix,
+    // reusing its storage if it already has the right size.
+    template <matrix_expression E>
+        requires(!is_matrix_v<E>)
+    matrix &operator=(const E &);
+
+    // Member function to obtain (but not modify) the number of rows in the matrix.
+    uint64_t get_rows() const;
+
+    // Member function to obtain (but not modify) the number of columns in the matrix.
+    uint64_t get_cols() const;
+
+    // Overloaded operator () to access matrix elements WITHOUT range checking.
+    // The indices start from 0: m(0, 1) would be the element at row 1, column 2.
+    // First version: allows modification of the element.
+    T &operator()(const uint64_t &, const uint64_t &);
+
+    // Overloaded operator () to access matrix elements WITHOUT range checking.
+    // The indices start from 0: m(0, 1) would be the element at row 1, column 2.
+    // Second version: does not allow modification of the element.
+    const T &operator()(const uint64_t &, const uint64_t &) const;
+
+    // Member function to access matrix elements WITH range checking (throws out_of_range via vector::at).
+    // The indices start from 0: m.at(0, 1) would be the element at row 1, column 2.
+    // First version: allows modification of the element.
+    T &at(const uint64_t &, const uint64_t &);
+
+    // Member function to access matrix elements WITH range checking (throws out_of_range via vector::at).
+    // The indices start from 0: m.at(0, 1) would be the element at row 1, column 2.
+    // Second version: does not allow modification of the element.
+    const T &at(const uint64_t &, const uint64_t &) const;
+
+    // Member function to access a whole row as a span WITHOUT range checking (no copy is made).
+    // First version: allows modification of the elements.
+    span<T> row(const uint64_t &);
+
+    // Member function to access a whole row as a span WITHOUT range checking (no copy is made).
+    // Second version: does not allow modification of the elements.
+    span<const T> row(const uint64_t &) const;
+
+    // Member function to access a whole column as a strided view WITHOUT range checking (no copy is made).
+    // First version: allows modification of the elements.
+    column_view<T> col(const uint64_t &);
+
+    // Member function to access a whole column as a strided view WITHOUT range checking (no copy is made).
+    // Second version: does not allow modification of the elements.
+    column_view<const T> col(const uint64_t &) const;
+
+    // Member function to access a rectangular part of the matrix WITH range checking (no copy is made).
+    // First argument: the first row. Second argument: the first column.
+    // Third argument: number of rows. Fourth argument: number of columns.
+    // First version: allows modification of the elements.
+    matrix_view<T> block(const uint64_t &, const uint64_t &, const uint64_t &, const uint64_t &);
+
+    // Member function to access a rectangular part of the matrix WITH range checking (no copy is made).
+    // First argument: the first row. Second argument: the first column.
+    // Third argument: number of rows. Fourth argument: number of columns.
+    // Second version: does not allow modification of the elements.
+    matrix_view<const T> block(const uint64_t &, const uint64_t &, const uint64_t &, const uint64_t &) const;
+
+    // Member function to obtain (but not modify) an element by its index in flattened (row-major) form.
+    // This is how expressions read the matrix.
+    const T &element(const uint64_t &) const;
+
+    // Member function to obtain a copy of the allocator of the elements.
+    Alloc get_allocator() const;
+
+    // Member function to access the elements in flattened (row-major) form.
+    // First version: allows modification of the elements.
+    T *data();
+
+    // Member function to access the elements in flattened (row-major) form.
+    // Second version: does not allow modification of the elements.
+    const T *data() const;
+
+    // Member function to add rows at the bottom of the matrix, given in flattened (row-major) form.
+    // The storage grows geometrically, so appending many small batches costs amortized O(1) per element.
+    // The number of elements must be a multiple of the number of columns.
+    void append_rows(span<const T>);
+
+    // Exception to be thrown if the number of rows or columns given to the constructor is zero.
+    class zero_size : public invalid_argument
+    {
+    public:
+        zero_size() : invalid_argument("Matrix cannot have zero rows or columns!"){};
+    };
+
+    // Exception to be thrown if the vector of elements provided to the constructor is of the wrong size.
+    class initializer_wrong_size : public invalid_argument
+    {
+    public:
+        initializer_wrong_size() : invalid_argument("Initializer does not have the expected number of elements!"){};
+    };
+
+    // Exception to be thrown if two matrices of different sizes are added or subtracted (the same type for all matrices).
+    using incompatible_sizes_add = matrix_incompatible_sizes_add;
+
+    // Exception to be thrown if two matrices of incompatible sizes are multiplied.
+    class incompatible_sizes_multiply : public invalid_argument
+    {
+    public:
+        incompatible_sizes_multiply() : invalid_argument("Two matrices can only be multiplied if the number of columns in the first matrix is equal to the number of rows in the second matrix!"){};
+    };
+
+private:
+    // Member function to obtain the allocator to evaluate an expression with: a copy of the allocator of the leftmost matrix
+    // in the expression if it converts to Alloc, and a default Alloc otherwise.
+    template <matrix_expression E>
+    static Alloc allocator_for(const E &);
+
+    // The number of rows.
+    uint64_t rows = 0;
+
+    // The number of columns.
+    uint64_t cols = 0;
+
+    // A vector storing the elements of the matrix in flattened (1-dimensional) form.
+    vector<T, Alloc> elements;
+};
+
+// A non-owning view of one column of a matrix: its elements are a fixed distance (the number of columns) apart.
+// T is const for a read-only view. The view is valid as long as the matrix is not resized or destroyed.
+template <typename T>
+class column_view
+{
+public:
+    // Constructor of a view.
+    // First argument: the first element. Second argument: number of elements. Third argument: distance between elements.
+    column_view(T *_first, const uint64_t &_size, const uint64_t &_stride) : first(_first), count(_size), stride(_stride) {}
+
+    // Member function to obtain the number of elements.
+    uint64_t size() const { return count; }
+
+    // Overloaded operator [] to access the elements WITHOUT range checking.
+    T &operator[](const uint64_t &i) const { return first[i * stride]; }
+
+private:
+    // The first element.
+    T *first;
+
+    // The number of elements.
+    uint64_t count;
+
+    // The distance between consecutive elements.
+    uint64_t stride;
+};
+
+// A non-owning view of a rectangular part of a matrix. T is const for a read-only view.
+// The view is valid as long as the matrix is not resized or destroyed.
+// It can be used in element-wise expressions, and copied into a matrix: matrix<double> m = a.block(0, 0, 10, 2);
+template <typename T>
+class matrix_view
+{
+public:
+    // The type of the elements.
+    using value_type = remove_const_t<T>;
+
+    // Constructor of a view.
+    // First argument: the first element. Second argument: number of rows.
+    // Third argument: number of columns. Fourth argument: distance between the beginnings of consecutive rows.
+    matrix_view(T *_first, const uint64_t &_rows, const uint64_t &_cols, const uint64_t &_stride)
+        : first(_first), rows(_rows), cols(_cols), stride(_stride) {}
+
+    // Member function to obtain the number of rows in the view.
+    uint64_t get_rows() const { return rows; }
+
+    // Member function to obtain the number of columns in the view.
+    uint64_t get_cols() const { return cols; }
+
+    // Overloaded operator () to access the elements WITHOUT range checking.
+    // The indices start from 0 and are relative to the view.
+    T &operator()(const uint64_t &row, const uint64_t &col) const { return first[(stride * row) + col]; }
+
+    // Member function to access a whole row of the view as a span WITHOUT range checking.
+    span<T> row(const uint64_t &row) const { return span<T>(first + (stride * row), cols); }
+
+    // Member function to access a whole column of the view as a strided view WITHOUT range checking.
+    column_view<T> col(const uint64_t &col) const { return column_view<T>(first + col, rows, stride); }
+
+    // Member function to obtain (but not modify) an element by its index in flattened (row-major) form.
+    // This is how expressions read the view.
+    const value_type &element(const uint64_t &i) const { return first[(stride * (i / cols)) + (i % cols)]; }
+
+private:
+    // The first element.
+    T *first;
+
+    // The number of rows.
+    uint64_t rows;
+
+    // The number of columns.
+    uint64_t cols;
+
+    // The distance between the beginnings of consecutive rows.
+    uint64_t stride;
+};
+
+// A matrix stored column by column, so that the values of each column are contiguous.
+template <typename T, typename Alloc = allocator<T>>
+class column_matrix
+{
+public:
+    // Constructor to create a zero matrix.
+    // First argument: number of rows.
+    // Second argument: number of columns.
+    column_matrix(const uint64_t &, const uint64_t &);
+
+    // Constructor to create a matrix from a vector, taking over its storage instead of copying it.
+    // First argument: number of rows.
+    // Second argument: number of columns.
+    // Third argument: an rvalue vector containing the elements in column-major order.
+    column_matrix(const uint64_t &, const uint64_t &, vector<T, Alloc> &&);
+
+    // Member function to obtain (but not modify) the number of rows in the matrix.
+    uint64_t get_rows() const;
+
+    // Member function to obtain (but not modify) the number of columns in the matrix.
+    uint64_t get_cols() const;
+
+    // Overloaded operator () to access matrix elements WITHOUT range checking.
+    // The indices start from 0: m(0, 1) would be the element at row 1, column 2.
+    // First version: allows modification of the element.
+    T &operator()(const uint64_t &, const uint64_t &);
+
+    // Overloaded operator () to access matrix elements WITHOUT range checking.
+    // The indices start from 0: m(0, 1) would be the element at row 1, column 2.
+    // Second version: does not allow modification of the element.
+    const T &operator()(const uint64_t &, const uint64_t &) const;
+
+    // Member function to access matrix elements WITH range checking (throws out_of_range via vector::at).
+    // The indices start from 0: m.at(0, 1) would be the element at row 1, column 2.
+    // First version: allows modification of the element.
+    T &at(const uint64_t &, const uint64_t &);
+
+    // Member function to access matrix elements WITH range checking (throws out_of_range via vector::at).
+    // The indices start from 0: m.at(0, 1) would be the element at row 1, column 2.
+    // Second version: does not allow modification of the element.
+    const T &at(const uint64_t &, const uint64_t &) const;
+
+    // Member function to access a whole column as a contiguous span WITHOUT range checking.
+    // First version: allows modification of the elements.
+    span<T> column(const uint64_t &);
+
+    // Member function to access a whole column as a contiguous span WITHOUT range checking.
+    // Second version: does not allow modification of the elements.
+    span<const T> column(const uint64_t &) const;
+
+    // Exception to be thrown if the number of rows or columns given to the constructor is zero.
+    class zero_size : public invalid_argument
+    {
+    public:
+        zero_size() : invalid_argument("Matrix cannot have zero rows or columns!"){};
+    };
+
+    // Exception to be thrown if the vector of elements provided to the constructor is of the wrong size.
+    class initializer_wrong_size : public invalid_argument
+    {
+    public:
+        initializer_wrong_size() : invalid_argument("Initializer does not have the expected number of elements!"){};
+    };
+
+private:
+    // The number of rows.
+    uint64_t rows = 0;
+
+    // The number of columns.
+    uint64_t cols = 0;
+
+    // A vector storing the elements of the matrix in column-major order.
+    vector<T, Alloc> elements;
+};
+
+// A matrix whose storage is aligned to a cache line.
+template <typename T>
+using aligned_matrix = matrix<T, aligned_allocator<T>>;
+
+// Overloaded binary operator << to easily print out a matrix to a stream.
+template <typename T, typename Alloc>
+ostream &operator<<(ostream &, const matrix<T, Alloc> &);
+
+// Overloaded binary operator << to easily print out a column-major matrix to a stream (row by row).
+template <typename T, typename Alloc>
+ostream &operator<<(ostream &, const column_matrix<T, Alloc> &);
+
+// An element-wise expression combining two expressions, such as a + b.
+// Matrices are kept by reference, and nested expressions by value (see matrix_expression for their lifetime).
+template <matrix_expression L, matrix_expression R, typename Op>
+class matrix_binary_expression
+{
+public:
+    using value_type = typename L::value_type;
+
+    // Constructor checking that the two operands have the same dimensions.
+    matrix_binary_expression(const L &, const R &);
+
+    uint64_t get_rows() const { return left.get_rows(); }
+    uint64_t get_cols() const { return left.get_cols(); }
+    value_type element(const uint64_t &i) const { return Op()(left.element(i), right.element(i)); }
+
+    // Member function to obtain a copy of the allocator of the leftmost matrix in the expression.
+    auto get_allocator() const
+        requires(allocator_expression<L> or allocator_expression<R>)
+    {
+        if constexpr (allocator_expression<L>)
+            return left.get_allocator();
+        else
+            return right.get_allocator();
+    }
+
+private:
+    conditional_t<is_matrix_v<L>, const L &, const L> left;
+    conditional_t<is_matrix_v<R>, const R &, const R> right;
+};
+
+// An element-wise expression applying an operation to one expression, such as -a.
+template <matrix_expression E, typename Op>
+class matrix_unary_expression
+{
+public:
+    using value_type = typename E::value_type;
+
+    matrix_unary_expression(const E &_operand) : operand(_operand) {}
+
+    uint64_t get_rows() const { return operand.get_rows(); }
+    uint64_t get_cols() const { return operand.get_cols(); }
+    value_type element(const uint64_t &i) const { return Op()(operand.element(i)); }
+
+    // Member function to obtain a copy of the allocator of the leftmost matrix in the expression.
+    auto get_allocator() const
+        requires allocator_expression<E>
+    {
+        return operand.get_allocator();
+    }
+
+private:
+    conditional_t<is_matrix_v<E>, const E &, const E> operand;
+};
+
+// An element-wise expression multiplying an expression by a scalar, such as 2.0 * a.
+template <matrix_expression E>
+class matrix_scalar_expression
+{
+public:
+    using value_type = typename E::value_type;
+
+    matrix_scalar_expression(const value_type &_scalar, const E &_operand) : scalar(_scalar), operand(_operand) {}
+
+    uint64_t get_rows() const { return operand.get_rows(); }
+    uint64_t get_cols() const { return operand.get_cols(); }
+    value_type element(const uint64_t &i) const { return scalar * operand.element(i); }
+
+    // Member function to obtain a copy of the allocator of the leftmost matrix in the expression.
+    auto get_allocator() const
+        requires allocator_expression<E>
+    {
+        return operand.get_allocator();
+    }
+
+private:
+    value_type scalar;
+    conditional_t<is_matrix_v<E>, const E &, const E> operand;
+};
+
+// Function to obtain a copy of the allocator of the leftmost matrix in an expression,
+// or a std::allocator if the expression has no matrix in it (only views).
+template <matrix_expression E>
+auto expression_allocator(const E &);
+
+// Function to use a matrix as it is, or to evaluate an expression into a new matrix,
+// whose storage comes from the allocator of the leftmost matrix in the expression.
+template <matrix_expression E>
+decltype(auto) evaluate(const E &);
+
+// Overloaded binary operator << to print out an expression, after evaluating it.
+template <matrix_expression E>
+    requires(!is_matrix_v<E>)
+ostream &operator<<(ostream &, const E &);
+
+// Overloaded binary operator + to add two matrices (or expressions), lazily.
+template <matrix_expression L, matrix_expression R>
+    requires same_as<typename L::value_type, typename R::value_type>
+matrix_binary_expression<L, R, plus<>> operator+(const L &, const R &);
+
+// Overloaded binary operator += to add a matrix (or expression) to the first one, in place.
+template <typename T, typename Alloc, matrix_expression E>
+matrix<T, Alloc> &operator+=(matrix<T, Alloc> &, const E &);
+
+// Overloaded unary operator - to take the negative of a matrix (or expression), lazily.
+template <matrix_expression E>
+matrix_unary_expression<E, negate<>> operator-(const E &);
+
+// Overloaded binary operator - to subtract two matrices (or expressions), lazily.
+template <matrix_expression L, matrix_expression R>
+    requires same_as<typename L::value_type, typename R::value_type>
+matrix_binary_expression<L, R, minus<>> operator-(const L &, const R &);
+
+// Overloaded binary operator -= to subtract a matrix (or expression) from the first one, in place.
+template <typename T, typename Alloc, matrix_expression E>
+matrix<T, Alloc> &operator-=(matrix<T, Alloc> &, const E &);
+
+// Overloaded binary operator * to multiply two matrices.
+// The product is computed in cache-sized tiles, four rows at a time, with a contiguous (vectorizable) inner loop,
+// and large products are split by rows over all hardware threads.
+template <typename T, typename Alloc, typename Alloc2>
+matrix<T, Alloc> operator*(const matrix<T, Alloc> &, const matrix<T, Alloc2> &);
+
+// Overloaded binary operator * to multiply two expressions (at least one of them not a matrix).
+// The expressions are evaluated first, and the product has the allocator of the left one (as for two matrices).
+template <matrix_expression L, matrix_expression R>
+    requires(same_as<typename L::value_type, typename R::value_type> and !(is_matrix_v<L> and is_matrix_v<R>))
+auto operator*(const L &, const R &);
+
+// Whether a scalar of type S can multiply the elements of type T without changing its value: S converts to T
+// without narrowing, or S is an integer and T is floating-point (so that 2 * a works for a matrix<double>, but 2.5 * a does not compile for a matrix<int>).
+template <typename S, typename T>
+concept matrix_scalar = convertible_to<S, T> and (requires(const S &s) { T{s}; } or (integral<S> and floating_point<T>));
+
+// Overloaded binary operator * to multiply a scalar on the left and a matrix (or expression) on the right, lazily.
+template <typename S, matrix_expression E>
+    requires matrix_scalar<S, typename E::value_type>
+matrix_scalar_expression<E> operator*(const S &, const E &);
+
+// Overloaded binary operator * to multiply a matrix (or expression) on the left and a scalar on the right, lazily.
+template <matrix_expression E, typename S>
+    requires matrix_scalar<S, typename E::value_type>
+matrix_scalar_expression<E> operator*(const E &, const S &);
+
+// Overloaded binary operator *= to multiply a matrix by a scalar, in place.
+template <typename T, typename Alloc>
+matrix<T, Alloc> &operator*=(matrix<T, Alloc> &, const T &);
+
+// ==============
+// Implementation
+// ==============
+
+template <typename T, size_t Alignment, bool HugePages>
+size_t aligned_allocator<T, Alignment, HugePages>::alignment(const size_t &n)
+{
+    if (HugePages and n * sizeof(T) >= huge_page)
+        return max(Alignment, huge_page);
+    return max(Alignment, alignof(T));
+}
+
+template <typename T, size_t Alignment, bool HugePages>
+T *aligned_allocator<T, Alignment, HugePages>::allocate(const size_t &n)
+{
+    if (n > numeric_limits<size_t>::max() / sizeof(T))
+        throw bad_array_new_length();
+    void *p = ::operator new(n * sizeof(T), align_val_t(alignment(n)));
+#if defined(__linux__) and defined(MADV_HUGEPAGE)
+    if (HugePages and n * sizeof(T) >= huge_page)
+        madvise(p, (n * sizeof(T)) / huge_page * huge_page, MADV_HUGEPAGE);
+#endif
+    return (T *)p;
+}
+
+template <typename T, size_t Alignment, bool HugePages>
+void aligned_allocator<T, Alignment, HugePages>::deallocate(T *p, const size_t &n)
+{
+    ::operator delete(p, align_val_t(alignment(n)));
+}
+
+template <typename T, typename Alloc>
+matrix<T, Alloc>::matrix(const uint64_t &_rows, const uint64_t &_cols)
+    : rows(_rows), cols(_cols)
+{
+    if (rows == 0 or cols == 0)
+        throw zero_size();
+    elements = vector<T, Alloc>(rows * cols);
+}
+
+template <typename T, typename Alloc>
+matrix<T, Alloc>::matrix(const uint64_t &_rows, const uint64_t &_cols, const Alloc &_allocator)
+    : rows(_rows), cols(_cols), elements(_allocator)
+{
+    if (rows == 0 or cols == 0)
+        throw zero_size();
+    elements.resize(rows * cols);
+}
+
+template <typename T, typename Alloc>
+matrix<T, Alloc>::matrix(const vector<T> &_diagonal)
+    : rows(_diagonal.size()), cols(_diagonal.size())
+{
+    if (rows == 0)
+        throw zero_size();
+    elements = vector<T, Alloc>(rows * cols);
+    for (uint64_t i = 0; i < rows; i++)
+        elements[(cols * i) + i] = _diagonal[i];
+}
+
+template <typename T, typename Alloc>
+matrix<T, Alloc>::matrix(const initializer_list<T> &_diagonal)
+    : matrix(vector<T>(_diagonal)) {}
+
+template <typename T, typename Alloc>
+matrix<T, Alloc>::matrix(const uint64_t &_rows, const uint64_t &_cols, const vector<T> &_elements)
+    : rows(_rows), cols(_cols), elements(_elements.begin(), _elements.end())
+{
+    if (rows == 0 or cols == 0)
+        throw zero_size();
+    if (_elements.size() != rows * cols)
+        throw initializer_wrong_size();
+}
+
+template <typename T, typename Alloc>
+matrix<T, Alloc>::matrix(const uint64_t &_rows, const uint64_t &_cols, vector<T, Alloc> &&_elements)
+    : rows(_rows), cols(_cols), elements(move(_elements))
+{
+    if (rows == 0 or cols == 0)
+        throw zero_size();
+    if (elements.size() != rows * cols)
+        throw initializer_wrong_size();
+}
+
+template <typename T, typename Alloc>
+matrix<T, Alloc>::matrix(const uint64_t &_rows, const uint64_t &_cols, const initializer_list<T> &_elements)
+    : matrix(_rows, _cols, vector<T>(_elements)) {}
+
+template <typename T, typename Alloc>
+template <matrix_expression E>
+    requires(!is_matrix_v<E>)
+matrix<T, Alloc>::matrix(const E &e)
+    : matrix(e, allocator_for(e)) {}
+
+template <typename T, typename Alloc>
+template <matrix_expression E>
+    requires(!is_matrix_v<E>)
+matrix<T, Alloc>::matrix(const E &e, const Alloc &alloc)
+    : rows(e.get_rows()), cols(e.get_cols()), elements(alloc)
+{
+    if (rows == 0 or cols == 0)
+        throw zero_size();
+    elements.resize(rows * cols);
+    for (uint64_t i = 0; i < rows * cols; i++)
+        elements[i] = e.element(i);
+}
+
+template <typename T, typename Alloc>
+template <matrix_expression E>
+    requires(!is_matrix_v<E>)
+matrix<T, Alloc> &matrix<T, Alloc>::operator=(const E &e)
+{
+    if (e.get_rows() == 0 or e.get_cols() == 0)
+        throw zero_size();
+    // Element-wise expressions only read element i to write element i, so they may refer to this matrix
+    if (rows * cols != e.get_rows() * e.get_cols())
+        elements.resize(e.get_rows() * e.get_cols());
+    rows = e.get_rows();
+    cols = e.get_cols();
+    for (uint64_t i = 0; i < rows * cols; i++)
+        elements[i] = e.element(i);
+    return *this;
+}
+
+template <typename T, typename Alloc>
+template <matrix_expression E>
+Alloc matrix<T, Alloc>::allocator_for(const E &e)
+{
+    if constexpr (constructible_from<Alloc, decltype(expression_allocator(e))>)
+        return Alloc(expression_allocator(e));
+    else
+        return Alloc();
+}
+
+template <typename T, typename Alloc>
+uint64_t matrix<T, Alloc>::get_rows() const
+{
+    return rows;
+}
+
+template <typename T, typename Alloc>
+uint64_t matrix<T, Alloc>::get_cols() const
+{
+    return cols;
+}
+
+template <typename T, typename Alloc>
+T &matrix<T, Alloc>::operator()(const uint64_t &row, const uint64_t &col)
+{
+    return elements[(cols * row) + col];
+}
+
+template <typename T, typename Alloc>
+const T &matrix<T, Alloc>::operator()(const uint64_t &row, const uint64_t &col) const
+{
+    return elements[(cols * row) + col];
+}
+
+template <typename T, typename Alloc>
+T &matrix<T, Alloc>::at(const uint64_t &row, const uint64_t &col)
+{
+    return elements.at((cols * row) + col);
+}
+
+template <typename T, typename Alloc>
+const T &matrix<T, Alloc>::at(const uint64_t &row, const uint64_t &col) const
+{
+    return elements.at((cols * row) + col);
+}
+
+template <typename T, typename Alloc>
+span<T> matrix<T, Alloc>::row(const uint64_t &row)
+{
+    return span<T>(elements.data() + (cols * row), cols);
+}
+
+template <typename T, typename Alloc>
+span<const T> matrix<T, Alloc>::row(const uint64_t &row) const
+{
+    return span<const T>(elements.data() + (cols * row), cols);
+}
+
+template <typename T, typename Alloc>
+column_view<T> matrix<T, Alloc>::col(const uint64_t &col)
+{
+    return column_view<T>(elements.data() + col, rows, cols);
+}
+
+template <typename T, typename Alloc>
+column_view<const T> matrix<T, Alloc>::col(const uint64_t &col) const
+{
+    return column_view<const T>(elements.data() + col, rows, cols);
+}
+
+template <typename T, typename Alloc>
+matrix_view<T> matrix<T, Alloc>::block(const uint64_t &first_row, const uint64_t &first_col, const uint64_t &_rows, const uint64_t &_cols)
+{
+    if (first_row + _rows > rows or first_col + _cols > cols)
+        throw out_of_range("The block does not fit in the matrix!");
+    return matrix_view<T>(elements.data() + (cols * first_row) + first_col, _rows, _cols, cols);
+}
+
+template <typename T, typename Alloc>
+matrix_view<const T> matrix<T, Alloc>::block(const uint64_t &first_row, const uint64_t &first_col, const uint64_t &_rows, const uint64_t &_cols) const
+{
+    if (first_row + _rows > rows or first_col + _cols > cols)
+        throw out_of_range("The block does not fit in the matrix!");
+    return matrix_view<const T>(elements.data() + (cols * first_row) + first_col, _rows, _cols, cols);
+}
+
+template <typename T, typename Alloc>
+const T &matrix<T, Alloc>::element(const uint64_t &i) const
+{
+    return elements[i];
+}
+
+template <typename T, typename Alloc>
+Alloc matrix<T, Alloc>::get_allocator() const
+{
+    return elements.get_allocator();
+}
+
+template <typename T, typename Alloc>
+T *matrix<T, Alloc>::data()
+{
+    return elements.data();
+}
+
+template <typename T, typename Alloc>
+const T *matrix<T, Alloc>::data() const
+{
+    return elements.data();
+}
+
+template <typename T, typename Alloc>
+void matrix<T, Alloc>::append_rows(span<const T> values)
+{
+    if (values.size() % cols != 0)
+        throw initializer_wrong_size();
+    elements.insert(elements.end(), values.begin(), values.end());
+    rows += values.size() / cols;
+}
+
+template <typename T, typename Alloc>
+ostream &operator<<(ostream &out, const matrix<T, Alloc> &m)
+{
+    out << '\n';
+    for (uint64_t i = 0; i < m.get_rows(); i++)
+    {
+        out << "( ";
+        for (uint64_t j = 0; j < m.get_cols(); j++)
+            out << m(i, j) << '\t';
+        out << ")\n";
+    }
+    return out;
+}
+
+template <typename T, typename Alloc>
+column_matrix<T, Alloc>::column_matrix(const uint64_t &_rows, const uint64_t &_cols)
+    : rows(_rows), cols(_cols)
+{
+    if (rows == 0 or cols == 0)
+        throw zero_size();
+    elements = vector<T, Alloc>(rows * cols);
+}
+
+template <typename T, typename Alloc>
+column_matrix<T, Alloc>::column_matrix(const uint64_t &_rows, const uint64_t &_cols, vector<T, Alloc> &&_elements)
+    : rows(_rows), cols(_cols), elements(move(_elements))
+{
+    if (rows == 0 or cols == 0)
+        throw zero_size();
+    if (elements.size() != rows * cols)
+        throw initializer_wrong_size();
+}
+
+template <typename T, typename Alloc>
+uint64_t column_matrix<T, Alloc>::get_rows() const
+{
+    return rows;
+}
+
+template <typename T, typename Alloc>
+uint64_t column_matrix<T, Alloc>::get_cols() const
+{
+    return cols;
+}
+
+template <typename T, typename Alloc>
+T &column_matrix<T, Alloc>::operator()(const uint64_t &row, const uint64_t &col)
+{
+    return elements[(rows * col) + row];
+}
+
+template <typename T, typename Alloc>
+const T &column_matrix<T, Alloc>::operator()(const uint64_t &row, const uint64_t &col) const
+{
+    return elements[(rows * col) + row];
+}
+
+template <typename T, typename Alloc>
+T &column_matrix<T, Alloc>::at(const uint64_t &row, const uint64_t &col)
+{
+    if (row >= rows)
+        throw out_of_range("Row index out of range!");
+    return elements.at((rows * col) + row);
+}
+
+template <typename T, typename Alloc>
+const T &column_matrix<T, Alloc>::at(const uint64_t &row, const uint64_t &col) const
+{
+    if (row >= rows)
+        throw out_of_range("Row index out of range!");
+    return elements.at((rows * col) + row);
+}
+
+template <typename T, typename Alloc>
+span<T> column_matrix<T, Alloc>::column(const uint64_t &col)
+{
+    return span<T>(elements.data() + (rows * col), rows);
+}
+
+template <typename T, typename Alloc>
+span<const T> column_matrix<T, Alloc>::column(const uint64_t &col) const
+{
+    return span<const T>(elements.data() + (rows * col), rows);
+}
+
+template <typename T, typename Alloc>
+ostream &operator<<(ostream &out, const column_matrix<T, Alloc> &m)
+{
+    out << '\n';
+    for (uint64_t i = 0; i < m.get_rows(); i++)
+    {
+        out << "( ";
+        for (uint64_t j = 0; j < m.get_cols(); j++)
+            out << m(i, j) << '\t';
+        out << ")\n";
+    }
+    return out;
+}
+
+template <matrix_expression L, matrix_expression R, typename Op>
+matrix_binary_expression<L, R, Op>::matrix_binary_expression(const L &a, const R &b)
+    : left(a), right(b)
+{
+    if ((a.get_rows() != b.get_rows()) or (a.get_cols() != b.get_cols()))
+        throw matrix_incompatible_sizes_add();
+}
+
+template <matrix_expression E>
+auto expression_allocator(const E &e)
+{
+    if constexpr (allocator_expression<E>)
+        return e.get_allocator();
+    else
+        return allocator<typename E::value_type>();
+}
+
+template <matrix_expression E>
+decltype(auto) evaluate(const E &e)
+{
+    if constexpr (is_matrix_v<E>)
+        return (e);
+    else
+        return matrix<typename E::value_type, decltype(expression_allocator(e))>(e, expression_allocator(e));
+}
+
+template <matrix_expression E>
+    requires(!is_matrix_v<E>)
+ostream &operator<<(ostream &out, const E &e)
+{
+    return out << evaluate(e);
+}
+
+template <matrix_expression L, matrix_expression R>
+    requires same_as<typename L::value_type, typename R::value_type>
+matrix_binary_expression<L, R, plus<>> operator+(const L &a, const R &b)
+{
+    return matrix_binary_expression<L, R, plus<>>(a, b);
+}
+
+template <typename T, typename Alloc, matrix_expression E>
+matrix<T, Alloc> &operator+=(matrix<T, Alloc> &a, const E &b)
+{
+    if ((a.get_rows() != b.get_rows()) or (a.get_cols() != b.get_cols()))
+        throw matrix_incompatible_sizes_add();
+    T *elements = a.data();
+    for (uint64_t i = 0; i < a.get_rows() * a.get_cols(); i++)
+        elements[i] += b.element(i);
+    return a;
+}
+
+template <matrix_expression E>
+matrix_unary_expression<E, negate<>> operator-(const E &m)
+{
+    return matrix_unary_expression<E, negate<>>(m);
+}
+
+template <matrix_expression L, matrix_expression R>
+    requires same_as<typename L::value_type, typename R::value_type>
+matrix_binary_expression<L, R, minus<>> operator-(const L &a, const R &b)
+{
+    return matrix_binary_expression<L, R, minus<>>(a, b);
+}
+
+template <typename T, typename Alloc, matrix_expression E>
+matrix<T, Alloc> &operator-=(matrix<T, Alloc> &a, const E &b)
+{
+    if ((a.get_rows() != b.get_rows()) or (a.get_cols() != b.get_cols()))
+        throw matrix_incompatible_sizes_add();
+    T *elements = a.data();
+    for (uint64_t i = 0; i < a.get_rows() * a.get_cols(); i++)
+        elements[i] -= b.element(i);
+    return a;
+}
+
+namespace csv_detail
+{
+    // Runs task(0), ..., task(n - 1) on n threads (one of them is the calling thread) and waits for all of them.
+    // If a thread cannot be started, the threads already started are joined before the exception goes on.
+    template <typename F>
+    void run_in_parallel(const uint64_t &n, const F &task)
+    {
+        vector<thread> workers;
+        workers.reserve(n);
+        try
+        {
+            for (uint64_t k = 1; k < n; k++)
+                workers.emplace_back(task, k);
+            task(0);
+        }
+        catch (...)
+        {
+            for (thread &worker : workers)
+                worker.join();
+            throw;
+        }
+        for (thread &worker : workers)
+            worker.join();
+    }
+} // namespace csv_detail
+
+// Multiplies rows [first_row, last_row) of a (n x m) by b (m x p), adding the result to the same rows of c (n x p).
+// The inner dimension and the columns of b are split into tiles that stay in cache while they are reused,
+// and each pass over a row of b updates four rows of c, so that every loaded element of b is used four times.
+template <typename T>
+void multiply_rows(const T *a, const T *b, T *c, const uint64_t &m, const uint64_t &p, const uint64_t &first_row, const uint64_t &last_row)
+{
+    const uint64_t k_tile = 128;
+    const uint64_t j_tile = 512;
+    for (uint64_t kk = 0; kk < m; kk += k_tile)
+    {
+        uint64_t k_end = min(kk + k_tile, m);
+        for (uint64_t jj = 0; jj < p; jj += j_tile)
+        {
+            uint64_t j_end = min(jj + j_tile, p);
+            uint64_t i = first_row;
+            for (; i + 4 <= last_row; i += 4)
+            {
+                T *c0 = c + i * p;
+                T *c1 = c0 + p;
+                T *c2 = c1 + p;
+                T *c3 = c2 + p;
+                for (uint64_t k = kk; k < k_end; k++)
+                {
+                    const T a0 = a[i * m + k];
+                    const T a1 = a[(i + 1) * m + k];
+                    const T a2 = a[(i + 2) * m + k];
+                    const T a3 = a[(i + 3) * m + k];
+                    const T *bk = b + k * p;
+                    for (uint64_t j = jj; j < j_end; j++)
+                    {
+                        const T bkj = bk[j];
+                        c0[j] += a0 * bkj;
+                        c1[j] += a1 * bkj;
+                        c2[j] += a2 * bkj;
+                        c3[j] += a3 * bkj;
+                    }
+                }
+            }
+            for (; i < last_row; i++)
+            {
+                T *ci = c + i * p;
+                for (uint64_t k = kk; k < k_end; k++)
+                {
+                    const T aik = a[i * m + k];
+                    const T *bk = b + k * p;
+                    for (uint64_t j = jj; j < j_end; j++)
+                        ci[j] += aik * bk[j];
+                }
+            }
+        }
+    }
+}
+
+template <typename T, typename Alloc, typename Alloc2>
+matrix<T, Alloc> operator*(const matrix<T, Alloc> &a, const matrix<T, Alloc2> &b)
+{
+    if (a.get_cols() != b.get_rows())
+        throw typename matrix<T, Alloc>::incompatible_sizes_multiply();
+    const uint64_t n = a.get_rows();
+    const uint64_t m = a.get_cols();
+    const uint64_t p = b.get_cols();
+    matrix<T, Alloc> c(n, p, Alloc(a.get_allocator()));
+
+    // Small products are not worth the threads
+    uint64_t threads = max<uint64_t>(thread::hardware_concurrency(), 1);
+    if (n * m * p < (1ULL << 21))
+        threads = 1;
+    // Each thread gets a band of rows (a multiple of 4, to keep the four-row kernel busy)
+    threads = min(threads, (n + 3) / 4);
+    uint64_t band = ((n + threads - 1) / threads + 3) / 4 * 4;
+    csv_detail::run_in_parallel((n + band - 1) / band, [&](uint64_t k)
+                                { multiply_rows(a.data(), b.data(), c.data(), m, p, k * band, min((k + 1) * band, n)); });
+    return c;
+}
+
+template <matrix_expression L, matrix_expression R>
+    requires(same_as<typename L::value_type, typename R::value_type> and !(is_matrix_v<L> and is_matrix_v<R>))
+auto operator*(const L &a, const R &b)
+{
+    return evaluate(a) * evaluate(b);
+}
+
+template <typename S, matrix_expression E>
+    requires matrix_scalar<S, typename E::value_type>
+matrix_scalar_expression<E> operator*(const S &s, const E &m)
+{
+    return matrix_scalar_expression<E>(s, m);
+}
+
+template <matrix_expression E, typename S>
+    requires matrix_scalar<S, typename E::value_type>
+matrix_scalar_expression<E> operator*(const E &m, const S &s)
+{
+    return matrix_scalar_expression<E>(s, m);
+}
+
+template <typename T, typename Alloc>
+matrix<T, Alloc> &operator*=(matrix<T, Alloc> &m, const T &s)
+{
+    T *elements = m.data();
+    for (uint64_t i = 0; i < m.get_rows() * m.get_cols(); i++)
+        elements[i] *= s;
+    return m;
+}
@@ -1,59 +1,981 @@
-#include <iostream>
-#include "ReadCSV.hpp"
-//#include "matrix.hpp"
-
-using namespace std;
-
-int main()
-{
-    /**
-     * @mainpage
-     * A sample run for 'ReadCSV' header.
-     * Reading a csv file, with only numeric values.
-     */
-    uint64_t Nrows, Ncols;
-    vector<double> Row_number;
-    string headers;
-
-    try
-    {
-        csv<double> my_dataset("all_number.csv");
-        Nrows = my_dataset.get_NRows();
-        Ncols = my_dataset.get_NCols();
-        headers = my_dataset.get_header();
-    }
-    catch (const exception &e)
-    {
-        cout << e.what();
-        return -1;
-    }
-    // Saving our data set into a matrix
-    matrix<double> MatrixData(Nrows, (Ncols + 1));
-    matrix<double> MatrixData2(Nrows, Ncols);
-    try
-    {
-        csv<double> my_dataset("all_number.csv");
-        MatrixData = my_dataset.read_data(false);
-        MatrixData2 = my_dataset.read_data(true);
-    }
-    catch (const exception &e)
-    {
-        cout << e.what();
-        return -1;
-    }
-    cout << "\nHeaders: " << headers << "\n\n";
-    cout << "\nWithout row numbers:" << MatrixData;
-    cout << "\nWith row numbers:" << MatrixData2 << "\n\n";
-
-    try
-    {
-        csv<double> my_dataset("anything.csv");
-    }
-    catch (const exception &e)
-    {
-        cout << e.what();
-        return -1;
-    }
-
-    cout << "This line will NOT be printed!\n";
-}
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <memory_resource>
+#include <sstream>
+#include "ReadCSV.hpp"
+#include "WriteCSV.hpp"
+//#include "matrix.hpp"
+
+using namespace std;
+
+/**
+ * @brief Number of checks that failed.
+ */
+uint64_t failed_checks = 0;
+
+/**
+ * @brief Prints the result of a check, and counts it if it failed.
+ * @param passed Whether the check passed.
+ * @param name What was checked.
+ */
+void check(const bool &passed, const string &name)
+{
+    cout << (passed ? "passed: " : "FAILED: ") << name << "\n";
+    if (!passed)
+        failed_checks++;
+}
+
+/**
+ * @brief Compares the product of two matrices (n x m and m x p) with a naive triple loop.
+ * The values are small integers, so both sums are exact and must be equal.
+ */
+bool multiply_matches(const uint64_t &n, const uint64_t &m, const uint64_t &p)
+{
+    matrix<double> A(n, m), B(m, p);
+    for (uint64_t i = 0; i < n * m; i++)
+        A.data()[i] = (double)((i * 7 + 3) % 19) - 9;
+    for (uint64_t i = 0; i < m * p; i++)
+        B.data()[i] = (double)((i * 5 + 1) % 13) - 6;
+    matrix<double> C = A * B;
+    for (uint64_t i = 0; i < n; i++)
+        for (uint64_t j = 0; j < p; j++)
+        {
+            double sum = 0;
+            for (uint64_t k = 0; k < m; k++)
+                sum += A(i, k) * B(k, j);
+            if (C(i, j) != sum)
+                return false;
+        }
+    return true;
+}
+
+/**
+ * @brief Checks the tiled product on sizes that are not multiples of the tiles (and of the four-row kernel).
+ */
+void check_multiply()
+{
+    check(multiply_matches(1, 600, 700), "A * B, 1 x 600 by 600 x 700");
+    check(multiply_matches(700, 600, 1), "A * B, 700 x 600 by 600 x 1");
+    check(multiply_matches(5, 1, 7), "A * B, 5 x 1 by 1 x 7");
+    check(multiply_matches(130, 129, 131), "A * B, 130 x 129 by 129 x 131");
+    check(multiply_matches(513, 513, 513), "A * B, 513 x 513 by 513 x 513");
+
+    // A product with an expression keeps the allocator of the left operand
+    aligned_matrix<double> A(2, 2, {1, 2, 3, 4}), B(2, 2, {1, 0, 0, 1});
+    aligned_matrix<double> C = A * (B + B);
+    check(C(0, 0) == 2 and C(0, 1) == 4 and C(1, 0) == 6 and C(1, 1) == 8, "aligned A * (B + B)");
+}
+
+/**
+ * @brief Whether a scalar of type S and a matrix of type M can be multiplied, in both orders.
+ */
+template <typename S, typename M>
+concept scalar_multipliable = requires(const S &s, const M &m) {
+    s * m;
+    m * s;
+};
+
+/**
+ * @brief Checks element-wise expressions on matrices with different allocators.
+ */
+void check_expressions()
+{
+    // Different sizes throw the same exception for an expression and for += and -=, whatever the allocator
+    matrix<double> A(2, 2, {1, 2, 3, 4});
+    aligned_matrix<double> B(2, 3);
+    uint64_t caught = 0;
+    try
+    {
+        matrix<double> C = A + B;
+    }
+    catch (const matrix<double>::incompatible_sizes_add &)
+    {
+        caught++;
+    }
+    try
+    {
+        B += A;
+    }
+    catch (const matrix<double>::incompatible_sizes_add &)
+    {
+        caught++;
+    }
+    try
+    {
+        B -= A - A;
+    }
+    catch (const matrix_incompatible_sizes_add &)
+    {
+        caught++;
+    }
+    check(caught == 3, "incompatible_sizes_add from A + B, B += A, and B -= A - A");
+
+    // A scalar that would be truncated does not compile, and an integer scalar still works with a floating-point matrix
+    check(scalar_multipliable<int, matrix<double>> and scalar_multipliable<float, matrix<double>> and scalar_multipliable<int, matrix<int64_t>>,
+          "scalar * matrix without narrowing compiles");
+    check(!scalar_multipliable<double, matrix<int>> and !scalar_multipliable<double, matrix<float>> and !scalar_multipliable<int64_t, matrix<int>>,
+          "scalar * matrix with narrowing does not compile");
+    matrix<double> D = 2 * A - A * 0.5f;
+    check(D(0, 0) == 1.5 and D(1, 1) == 6, "2 * A - A * 0.5f");
+
+    // An expression without rows or columns cannot make a matrix
+    caught = 0;
+    try
+    {
+        matrix<double> E = A.block(0, 0, 0, 2);
+    }
+    catch (const matrix<double>::zero_size &)
+    {
+        caught++;
+    }
+    try
+    {
+        D = A.block(1, 1, 1, 0);
+    }
+    catch (const matrix<double>::zero_size &)
+    {
+        caught++;
+    }
+    check(caught == 2 and D.get_rows() == 2, "zero_size from an empty block, in the constructor and in operator=");
+
+    // Evaluated expressions keep the allocator of their leftmost matrix
+    pmr::monotonic_buffer_resource arena;
+    pmr::polymorphic_allocator<double> arena_allocator(&arena);
+    using arena_matrix = matrix<double, pmr::polymorphic_allocator<double>>;
+    arena_matrix P(2, 2, arena_allocator), Q(2, 2, arena_allocator);
+    for (uint64_t i = 0; i < 4; i++)
+    {
+        P.data()[i] = (double)i + 1;
+        Q.data()[i] = (i == 0 or i == 3) ? 1 : 0;
+    }
+    arena_matrix M = P + Q;
+    check(M.get_allocator().resource() == &arena and M(0, 0) == 2 and M(1, 0) == 3, "M = P + Q keeps the arena of P");
+    auto R = (P + P) * Q;
+    check(same_as<decltype(R), arena_matrix> and R.get_allocator().resource() == &arena and R(1, 1) == 8,
+          "(P + P) * Q keeps the arena of P");
+    auto V = evaluate(A.block(0, 0, 2, 2) - 2.0 * Q);
+    check(same_as<decltype(V), arena_matrix> and V.get_allocator().resource() == &arena and V(0, 0) == -1,
+          "an expression of a view and a matrix keeps the arena of the matrix");
+    aligned_matrix<double> F(2, 2, {1, 2, 3, 4});
+    auto H = (F + F) * A;
+    check(same_as<decltype(H), aligned_matrix<double>> and (uintptr_t)H.data() % 64 == 0 and H(0, 0) == 14,
+          "(F + F) * A keeps the aligned allocator of F");
+}
+
+/**
+ * @brief Writes a file for a check.
+ */
+void write_file(const string &file_name, const string &text)
+{
+    ofstream output(file_name, ios::binary);
+    output << text;
+}
+
+/**
+ * @brief Checks whether rows are the same as rows [first, first + rows) of a data set read with row numbers.
+ */
+bool same_rows(const matrix<double> &rows, const matrix<double> &all, const uint64_t &first, const bool &row_num)
+{
+    uint64_t skip = row_num ? 0 : 1;
+    if (rows.get_cols() + skip != all.get_cols() or first + rows.get_rows() > all.get_rows())
+        return false;
+    for (uint64_t i = 0; i < rows.get_rows(); i++)
+        for (uint64_t j = 0; j < rows.get_cols(); j++)
+            if (rows(i, j) != all(first + i, j + skip))
+                return false;
+    return true;
+}
+
+/**
+ * @brief Checks that get_rows and get_row give the rows of read_data, with an index, a saved index, and none.
+ */
+void check_get_rows()
+{
+    string text = "a,b\n";
+    for (uint64_t i = 0; i < 1000; i++)
+        text += to_string(i) + "," + to_string(i * 2) + "\n";
+    write_file("check_rows.csv", text);
+    csv_options options;
+    options.index_step = 64;
+    options.index_file = true;
+    csv<double> indexed("check_rows.csv", options);
+    matrix<double> all = indexed.read_data(true);
+    check(same_rows(indexed.get_rows(500, 10, true), all, 500, true), "get_rows(500, 10, true) with index_step 64");
+    check(same_rows(indexed.get_rows(63, 2, false), all, 63, false), "get_rows across an indexed row");
+    check(same_rows(indexed.get_rows(0, 1000, false), all, 0, false), "get_rows of all the rows");
+    csv<double> loaded("check_rows.csv", options);
+    check(same_rows(loaded.get_row(999, true), all, 999, true), "get_row(999) with a saved index");
+    csv_options mapped;
+    mapped.mode = load_mode::mapped;
+    csv<double> unindexed("check_rows.csv", mapped);
+    check(same_rows(unindexed.get_rows(960, 40, true), all, 960, true), "get_rows without an index");
+    bool thrown = false;
+    try
+    {
+        indexed.get_rows(995, 10, false);
+    }
+    catch (const csv<double>::row_invalid &)
+    {
+        thrown = true;
+    }
+    check(thrown, "get_rows past the last row throws row_invalid");
+    filesystem::remove("check_rows.csv");
+    filesystem::remove("check_rows.csv.index");
+}
+
+/**
+ * @brief Writes rows [first, last) of the file used by check_refresh: i, i * 3.
+ */
+string refresh_rows(const uint64_t &first, const uint64_t &last)
+{
+    string text;
+    for (uint64_t i = first; i < last; i++)
+        text += to_string(i) + "," + to_string(i * 3) + "\n";
+    return text;
+}
+
+/**
+ * @brief Checks that refresh appends only the new rows, waits for an unfinished last line,
+ * and reads the file again when it is rewritten.
+ */
+void check_refresh()
+{
+    write_file("check_refresh.csv", "a,b\n" + refresh_rows(0, 100));
+    csv<double> growing("check_refresh.csv");
+    matrix<double> data(1, 1);
+    check(growing.refresh(data, true) == 100 and data.get_rows() == 100, "refresh: first call reads all the rows");
+
+    ofstream("check_refresh.csv", ios::binary | ios::app) << refresh_rows(100, 150) << "150,4";
+    uint64_t added = growing.refresh(data, true);
+    check(added == 50 and same_rows(data, csv<double>("check_refresh.csv").read_data(true), 0, true),
+          "refresh: 50 appended rows, without the unfinished last line");
+
+    ofstream("check_refresh.csv", ios::binary | ios::app) << "50\n";
+    added = growing.refresh(data, true);
+    check(added == 1 and data.get_rows() == 151 and data(150, 0) == 151 and data(150, 2) == 450,
+          "refresh: the last line once it is finished");
+
+    write_file("check_refresh.csv", "a,b\n7,7\n" + refresh_rows(1, 160));
+    growing.refresh(data, true);
+    check(data.get_rows() == 160 and data(0, 1) == 7 and same_rows(data, csv<double>("check_refresh.csv").read_data(true), 0, true),
+          "refresh: a rewritten file is read again");
+    filesystem::remove("check_refresh.csv");
+}
+
+/**
+ * @brief Checks quoted, trimmed, and sniffed dialects, and a quoted file read in parallel.
+ */
+void check_dialects()
+{
+    csv_options quoted;
+    quoted.dialect.quote = '"';
+    write_file("check_dialect.csv", "a,\"b,c\",\"q\"\"x\"\n1,\"2\",3\n\"-4.5\",5,\"6\"\n");
+    csv<double> quoted_file("check_dialect.csv", quoted);
+    matrix<double> values = quoted_file.read_data(false);
+    check(quoted_file.get_column_names() == vector<string>{"a", "b,c", "q\"x"} and values(0, 1) == 2 and values(1, 0) == -4.5 and values(1, 2) == 6,
+          "quoted names and values");
+
+    csv_options trimmed;
+    trimmed.dialect.delimiter = ';';
+    trimmed.dialect.trim = true;
+    write_file("check_dialect.csv", " a ; b\n 1 ;2 \n3; 4\n");
+    csv<double> trimmed_file("check_dialect.csv", trimmed);
+    values = trimmed_file.read_data(false);
+    check(trimmed_file.get_column_names() == vector<string>{"a", "b"} and values(0, 0) == 1 and values(1, 1) == 4, "trimmed fields with ';'");
+
+    csv_options sniffed;
+    sniffed.sniff = true;
+    write_file("check_dialect.csv", "a\tb\tc\n1\t2\t3\n4\t5\t6\n");
+    csv<double> tabs("check_dialect.csv", sniffed);
+    check(tabs.get_dialect().delimiter == '\t' and tabs.read_data(false)(1, 2) == 6, "sniffed tab delimiter");
+    write_file("check_dialect.csv", "a;b\n\"1\";2\n3;4\n");
+    csv<double> semicolons("check_dialect.csv", sniffed);
+    check(semicolons.get_dialect().delimiter == ';' and semicolons.get_dialect().quote == '"' and semicolons.read_data(false)(0, 0) == 1,
+          "sniffed ';' delimiter and quote");
+
+    // Quotes around every field, so the chunks of the threads start inside and outside quoted fields
+    string text = "x,y,z\n";
+    for (uint64_t i = 0; i < 20000; i++)
+        text += "\"" + to_string(i) + "\"," + to_string(i % 7) + ",\"" + to_string(i * 2) + "\"\n";
+    write_file("check_dialect.csv", text);
+    csv_options parallel = quoted;
+    parallel.mode = load_mode::mapped;
+    parallel.threads = 4;
+    matrix<double> one_thread = csv<double>("check_dialect.csv", quoted).read_data(true);
+    check(same_rows(csv<double>("check_dialect.csv", parallel).read_data(true), one_thread, 0, true) and one_thread.get_rows() == 20000,
+          "quoted file read by 4 threads");
+
+    csv_options invalid;
+    invalid.dialect.quote = ',';
+    bool thrown = false;
+    try
+    {
+        csv<double> same_characters("check_dialect.csv", invalid);
+    }
+    catch (const csv<double>::dialect_invalid &)
+    {
+        thrown = true;
+    }
+    check(thrown, "a quote equal to the delimiter throws dialect_invalid");
+    filesystem::remove("check_dialect.csv");
+}
+
+/**
+ * @brief Checks the skip_row and fill error modes, and that threads give the results of one thread,
+ * also for an encoded column whose missing cells are filled with a value that looks like a code.
+ */
+void check_error_modes()
+{
+    write_file("check_errors.csv", "a,b\n1,2\n3,x\n\n4\n5,6,7\n8,9\n");
+    csv_options skipping;
+    skipping.errors = error_mode::skip_row;
+    csv<double> skipped("check_errors.csv", skipping);
+    matrix<double> values = skipped.read_data(true);
+    check(values.get_rows() == 2 and values(0, 0) == 1 and values(1, 0) == 6 and values(1, 2) == 9, "skip_row keeps the valid rows");
+    // As the exceptions, a short row "expected more columns", and a long one "expected less columns"
+    const vector<parse_error> &log = skipped.get_errors();
+    check(skipped.get_NErrors() == 4 and log.size() == 4 and log[0].kind == error_kind::number_invalid and log[0].row == 2 and log[0].column == 1 and
+              log[1].kind == error_kind::empty_line and log[2].kind == error_kind::more_column and log[3].kind == error_kind::less_column,
+          "skip_row logs the invalid rows in order");
+
+    csv_options filling;
+    filling.errors = error_mode::fill;
+    filling.fill_value = -1;
+    filling.max_errors = 2;
+    csv<double> filled("check_errors.csv", filling);
+    values = filled.read_data(false);
+    check(values.get_rows() == 6 and values(1, 1) == -1 and values(2, 0) == -1 and values(3, 0) == 4 and values(3, 1) == -1 and values(5, 1) == 9,
+          "fill replaces the invalid and missing values");
+    check(filled.get_NErrors() == 4 and filled.get_errors().size() == 2, "max_errors bounds the error log");
+
+    bool thrown = false;
+    try
+    {
+        csv<double> strict("check_errors.csv");
+    }
+    catch (const csv<double>::empty_line &)
+    {
+        thrown = true;
+    }
+    check(thrown, "strict mode still throws empty_line");
+
+    // Short rows all over the file, so that every chunk of the threads has filled cells in the encoded column
+    string text = "id,name,x\n";
+    for (uint64_t i = 0; i < 200000; i++)
+        text += (i % 997 == 5) ? to_string(i) + "\n" : to_string(i) + ",n" + to_string(i % 5 + i / 50000) + "," + to_string(i % 3) + "\n";
+    write_file("check_errors.csv", text);
+    for (const error_mode &mode : {error_mode::fill, error_mode::skip_row})
+    {
+        csv_options serial;
+        serial.errors = mode;
+        serial.fill_value = 0;
+        serial.encode_columns = {"name"};
+        csv_options parallel = serial;
+        parallel.mode = load_mode::mapped;
+        parallel.threads = 4;
+        csv<double> one_thread("check_errors.csv", serial);
+        csv<double> threads("check_errors.csv", parallel);
+        matrix<double> expected = one_thread.read_data(true);
+        column_matrix<double> columns = threads.read_columns(true);
+        matrix<double> rows = csv<double>("check_errors.csv", parallel).read_data(true);
+        bool same = same_rows(rows, expected, 0, true) and rows.get_rows() == expected.get_rows() and columns.get_rows() == expected.get_rows() and
+                    threads.get_dictionary(1) == one_thread.get_dictionary(1) and threads.get_NErrors() == one_thread.get_NErrors();
+        for (uint64_t i = 0; i < columns.get_rows() and same; i++)
+            for (uint64_t j = 0; j < columns.get_cols(); j++)
+                same = same and columns(i, j) == expected(i, j);
+        check(same, string(mode == error_mode::fill ? "fill" : "skip_row") + " with an encoded column: 4 threads give the results of one");
+    }
+    filesystem::remove("check_errors.csv");
+}
+
+/**
+ * @brief Checks that a file written by csv_writer reads back to the same values,
+ * and that an option it cannot honour leaves an existing file as it is.
+ */
+void check_writer()
+{
+    matrix<double> values(3, 2, {0.1, -2.5, 1e-7, 123456789.125, 5e-324, -1.7976931348623157e308});
+    csv_write_options options;
+    options.row_numbers = true;
+    options.threads = 2;
+    {
+        csv_writer<double> output("check_writer.csv", {"a", "b,c"}, options);
+        output.write(values);
+        output.write(values);
+        output.close();
+    }
+    csv_options quoted;
+    quoted.dialect.quote = '"';
+    csv<double> written("check_writer.csv", quoted);
+    matrix<double> read = written.read_data(false);
+    bool same = read.get_rows() == 6 and read.get_cols() == 3 and written.get_column_names() == vector<string>{"row", "a", "b,c"};
+    for (uint64_t i = 0; i < 6 and same; i++)
+        same = read(i, 0) == (double)(i + 1) and read(i, 1) == values(i % 3, 0) and read(i, 2) == values(i % 3, 1);
+    check(same, "csv_writer output reads back to the same values");
+
+#ifndef READCSV_USE_ZLIB
+    options.gzip = true;
+    bool thrown = false;
+    try
+    {
+        csv_writer<double> compressed("check_writer.csv", {"a", "b,c"}, options);
+    }
+    catch (const csv_writer<double>::compression_unsupported &)
+    {
+        thrown = true;
+    }
+    check(thrown and csv<double>("check_writer.csv", quoted).get_NRows() == 6, "gzip without zlib throws and leaves the file as it is");
+#endif
+    filesystem::remove("check_writer.csv");
+}
+
+#ifdef READCSV_USE_ZLIB
+/**
+ * @brief Writes text as one gzip member, which starts the file (mode "wb") or is added at its end (mode "ab").
+ */
+void write_gzip(const string &file_name, const string &text, const char *mode)
+{
+    gzFile member = gzopen(file_name.c_str(), mode);
+    gzwrite(member, text.data(), (unsigned)text.size());
+    gzclose(member);
+}
+
+/**
+ * @brief Checks whether a data set read with read_data or read_columns (without row numbers) holds rows [0, rows) of i, i / 4.
+ */
+template <typename M>
+bool gzip_rows_match(const M &data, const uint64_t &rows)
+{
+    if (data.get_rows() != rows or data.get_cols() != 2)
+        return false;
+    for (uint64_t i = 0; i < rows; i++)
+        if (data(i, 0) != (double)i or data(i, 1) != (double)i / 4)
+            return false;
+    return true;
+}
+
+/**
+ * @brief Checks gzip files: written by csv_writer and read back, made of several gzip members, and cut short.
+ * The files have more rows than the first room of the result, so it grows while it is parsed.
+ */
+void check_gzip()
+{
+    const uint64_t rows = 5000;
+    matrix<double> values(rows, 2);
+    for (uint64_t i = 0; i < rows; i++)
+    {
+        values(i, 0) = (double)i;
+        values(i, 1) = (double)i / 4;
+    }
+    csv_write_options options;
+    options.gzip = true;
+    {
+        csv_writer<double> output("check_gzip.csv", {"a", "b"}, options);
+        output.write(values);
+        output.close();
+    }
+    check(gzip_rows_match(csv<double>("check_gzip.csv").read_data(false), rows) and
+              gzip_rows_match(csv<double>("check_gzip.csv").read_columns(false), rows),
+          "gzip: csv_writer output reads back to the same values, by rows and by columns");
+
+    // Truncated: the end of the gzip stream (and its trailer) is missing
+    ifstream input("check_gzip.csv", ios::binary);
+    string bytes((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+    input.close();
+    write_file("check_gzip.csv", bytes.substr(0, bytes.size() / 2));
+    bool thrown = false;
+    try
+    {
+        csv<double>("check_gzip.csv").read_data(false);
+    }
+    catch (const csv<double>::input_failed &)
+    {
+        thrown = true;
+    }
+    check(thrown, "gzip: a truncated file throws input_failed");
+
+    // Concatenated: each gzopen in append mode adds a gzip member, and the second one has an invalid row
+    string text = "a,b\n";
+    for (uint64_t i = 0; i < 2000; i++)
+        text += to_string(i) + "," + to_string((double)i / 4) + "\n";
+    write_gzip("check_gzip.csv", text, "wb");
+    text = "x,1\n";
+    for (uint64_t i = 2000; i < rows; i++)
+        text += to_string(i) + "," + to_string((double)i / 4) + "\n";
+    write_gzip("check_gzip.csv", text, "ab");
+    csv_options skipping;
+    skipping.errors = error_mode::skip_row;
+    csv<double> concatenated("check_gzip.csv", skipping);
+    check(gzip_rows_match(concatenated.read_columns(false), rows) and concatenated.get_NErrors() == 1 and
+              gzip_rows_match(csv<double>("check_gzip.csv", skipping).read_data(false), rows),
+          "gzip: concatenated members are read one after another");
+    filesystem::remove("check_gzip.csv");
+}
+
+/**
+ * @brief Checks that refresh on a gzip file returns only the rows added since the previous call,
+ * whether a member is appended or the file is compressed again, and reads all the rows if the old text changed.
+ */
+void check_gzip_refresh()
+{
+    write_gzip("check_refresh.csv", "a,b\n" + refresh_rows(0, 100), "wb");
+    csv<double> growing("check_refresh.csv");
+    matrix<double> data(1, 1);
+    check(growing.refresh(data, true) == 100 and data.get_rows() == 100, "gzip refresh: first call reads all the rows");
+
+    write_gzip("check_refresh.csv", refresh_rows(100, 150), "ab");
+    uint64_t added = growing.refresh(data, true);
+    check(added == 50 and same_rows(data, csv<double>("check_refresh.csv").read_data(true), 0, true), "gzip refresh: 50 rows in an appended member");
+
+    write_gzip("check_refresh.csv", "a,b\n" + refresh_rows(0, 170), "wb");
+    added = growing.refresh(data, true);
+    check(added == 20 and data.get_rows() == 170 and same_rows(data, csv<double>("check_refresh.csv").read_data(true), 0, true),
+          "gzip refresh: 20 rows in a file compressed again");
+
+    write_gzip("check_refresh.csv", "a,b\n7,7\n" + refresh_rows(1, 160), "wb");
+    added = growing.refresh(data, true);
+    check(added == 160 and data.get_rows() == 160 and data(0, 1) == 7, "gzip refresh: all the rows of a changed file");
+    filesystem::remove("check_refresh.csv");
+}
+#endif
+
+/**
+ * @brief Reads a file with one column and one value as csv<V>.
+ * @return bool True if the value is valid and equal to expected.
+ */
+template <typename V>
+bool reads_as(const string &text, const V &expected)
+{
+    write_file("check_number.csv", "a\n" + text + "\n");
+    try
+    {
+        return csv<V>("check_number.csv").read_data(false)(0, 0) == expected;
+    }
+    catch (const exception &)
+    {
+        return false;
+    }
+}
+
+/**
+ * @brief Checks whether csv<V> throws number_invalid for a file with one column and one value.
+ */
+template <typename V>
+bool rejects(const string &text)
+{
+    write_file("check_number.csv", "a\n" + text + "\n");
+    try
+    {
+        csv<V>("check_number.csv").read_data(false);
+    }
+    catch (const typename csv<V>::number_invalid &)
+    {
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Checks that integers are read exactly, without a detour through double, and that invalid ones are rejected.
+ */
+void check_numbers()
+{
+    check(reads_as<uint64_t>("9007199254740993", 9007199254740993ULL), "csv<uint64_t> reads 2^53 + 1 exactly");
+    check(reads_as<uint64_t>("18446744073709551615", 18446744073709551615ULL), "csv<uint64_t> reads 2^64 - 1 exactly");
+    check(reads_as<int64_t>("-9223372036854775807", -9223372036854775807LL), "csv<int64_t> reads -(2^63 - 1) exactly");
+    check(reads_as<int>("7.00", 7) and reads_as<int>(" 5. ", 5), "csv<int> reads a decimal point followed by zeros");
+    check(rejects<uint64_t>("-1"), "csv<uint64_t> rejects -1");
+    check(rejects<uint64_t>("18446744073709551616"), "csv<uint64_t> rejects 2^64");
+    check(rejects<uint64_t>("1.5") and rejects<int>(".5"), "integer types reject a fraction");
+    check(rejects<double>("1e5") and rejects<double>("nan") and reads_as<double>("-0.25", -0.25), "csv<double> reads fixed notation only");
+    filesystem::remove("check_number.csv");
+}
+
+/**
+ * @brief Checks that the batches of a file hold the rows of read_data, for batch sizes that do and do not divide the rows.
+ * The file is larger than two blocks of the reader, so rows also cross the blocks.
+ */
+void check_batches()
+{
+    const uint64_t rows = 100000;
+    string text = "a,b,c\n";
+    for (uint64_t i = 0; i < rows; i++)
+        text += to_string(i) + "," + to_string(i % 13) + "." + to_string(i * 7919 % 1000003) + "," + to_string(rows * 1000 - i * 999) + "\n";
+    write_file("check_batches.csv", text);
+    csv_options mapped;
+    mapped.mode = load_mode::mapped;
+    for (const csv_options &options : {csv_options(), mapped})
+    {
+        csv<double> data("check_batches.csv", options);
+        matrix<double> all = data.read_data(true);
+        for (const uint64_t &batch_rows : initializer_list<uint64_t>{1, 7, 4096, 100000, 150000})
+        {
+            bool same = true;
+            uint64_t next_row = 0;
+            for (const auto &batch : data.batches(batch_rows, true))
+            {
+                same = same and batch.get_first_row() == next_row and batch.get_cols() == 4 and batch.get_rows() == min(batch_rows, rows - next_row);
+                for (uint64_t i = 0; i < batch.get_rows() and same; i++)
+                    for (uint64_t j = 0; j < 4; j++)
+                        same = same and batch(i, j) == all(next_row + i, j);
+                next_row += batch.get_rows();
+            }
+            check(same and next_row == rows, string(options.mode == load_mode::mapped ? "mapped" : "stream") + ": batches(" + to_string(batch_rows) + ") hold the rows of read_data");
+        }
+    }
+    filesystem::remove("check_batches.csv");
+}
+
+/**
+ * @brief Checks whether opening a file with a selection of columns throws column_invalid.
+ */
+bool selection_rejected(const csv_options &options)
+{
+    try
+    {
+        csv<double> selected("check_columns.csv", options);
+    }
+    catch (const csv<double>::column_invalid &)
+    {
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Checks read_table: interned strings, integers beyond 2^53 kept exactly, numbers equal to those of read_data,
+ * and the exceptions for a wrong schema and a column accessed as the wrong type.
+ */
+void check_table()
+{
+    write_file("check_table.csv", "name,count,id,price\n"
+                                  "alice,-3,9007199254740993,1.5\n"
+                                  "bob,4,18446744073709551615,2.25\n"
+                                  "alice,5,9007199254740995,-0.125\n"
+                                  "carol,-9223372036854775808,0,10000000000\n");
+    table people = csv<double>("check_table.csv").read_table({column_type::string, column_type::int64, column_type::uint64, column_type::float64});
+    span<const uint32_t> names = people.string_codes(0);
+    check(people.get_rows() == 4 and people.get_cols() == 4 and people.get_NStrings() == 3 and names[0] == names[2] and names[0] != names[1] and
+              people.string_at(1, 0) == "bob" and people.get_string(names[3]) == "carol",
+          "read_table: strings are interned");
+
+    span<const int64_t> counts = people.int64_column(1);
+    span<const uint64_t> ids = people.uint64_column(2);
+    check(counts[0] == -3 and counts[3] == numeric_limits<int64_t>::min() and ids[0] == 9007199254740993ULL and
+              ids[1] == numeric_limits<uint64_t>::max() and ids[2] == 9007199254740995ULL,
+          "read_table: integers beyond 2^53 are exact");
+
+    csv_options numbers;
+    numbers.columns = {"count"};
+    matrix<int64_t> expected_counts = csv<int64_t>("check_table.csv", numbers).read_data(false);
+    numbers.columns = {"price"};
+    matrix<double> expected_prices = csv<double>("check_table.csv", numbers).read_data(false);
+    span<const double> prices = people.float64_column(3);
+    bool same = true;
+    for (uint64_t i = 0; i < 4; i++)
+        same = same and counts[i] == expected_counts(i, 0) and prices[i] == expected_prices(i, 0);
+    check(same, "read_table: numeric columns equal those of read_data");
+
+    uint64_t caught = 0;
+    try
+    {
+        people.int64_column(0);
+    }
+    catch (const table::wrong_type &)
+    {
+        caught++;
+    }
+    try
+    {
+        people.float64_column(2);
+    }
+    catch (const table::wrong_type &)
+    {
+        caught++;
+    }
+    check(caught == 2, "read_table: a column accessed as the wrong type throws wrong_type");
+
+    bool thrown = false;
+    try
+    {
+        csv<double>("check_table.csv").read_table({column_type::string, column_type::int64, column_type::uint64});
+    }
+    catch (const csv<double>::schema_invalid &)
+    {
+        thrown = true;
+    }
+    check(thrown, "read_table: a schema without one type per column throws schema_invalid");
+    filesystem::remove("check_table.csv");
+}
+
+/**
+ * @brief Checks that columns selected by name and by index are read in the given order, and that invalid selections throw.
+ */
+void check_projection()
+{
+    write_file("check_columns.csv", "a,b,c,d\n1,2,3,4\n5,6,7,8\n9,10,11,12\n");
+    matrix<double> all = csv<double>("check_columns.csv").read_data(false);
+    auto same_columns = [&](const matrix<double> &selected, const vector<uint64_t> &order)
+    {
+        if (selected.get_rows() != all.get_rows() or selected.get_cols() != order.size())
+            return false;
+        for (uint64_t i = 0; i < all.get_rows(); i++)
+            for (uint64_t j = 0; j < order.size(); j++)
+                if (selected(i, j) != all(i, order[j]))
+                    return false;
+        return true;
+    };
+
+    csv_options by_name;
+    by_name.columns = {"d", "b"};
+    csv<double> named("check_columns.csv", by_name);
+    check(same_columns(named.read_data(false), {3, 1}) and named.get_NCols() == 2 and named.get_column_names() == vector<string>{"d", "b"},
+          "columns by name keep the given order");
+
+    csv_options by_index;
+    by_index.column_indices = {2, 0};
+    check(same_columns(csv<double>("check_columns.csv", by_index).read_data(false), {2, 0}), "columns by index keep the given order");
+
+    csv_options both = by_name;
+    both.column_indices = {0};
+    csv_options mapped = both;
+    mapped.mode = load_mode::mapped;
+    mapped.threads = 2;
+    check(same_columns(csv<double>("check_columns.csv", both).read_data(false), {3, 1, 0}) and
+              same_columns(csv<double>("check_columns.csv", mapped).read_data(false), {3, 1, 0}),
+          "indices come after the names (stream and threads)");
+    column_matrix<double> columns = csv<double>("check_columns.csv", both).read_columns(false);
+    check(columns.get_cols() == 3 and columns(2, 0) == 12 and columns(2, 2) == 9, "read_columns with a selection");
+
+    csv_options duplicate_name;
+    duplicate_name.columns = {"a", "a"};
+    csv_options duplicate_mixed;
+    duplicate_mixed.columns = {"c"};
+    duplicate_mixed.column_indices = {2};
+    csv_options unknown_name;
+    unknown_name.columns = {"e"};
+    csv_options unknown_index;
+    unknown_index.column_indices = {4};
+    check(selection_rejected(duplicate_name) and selection_rejected(duplicate_mixed), "a column selected twice throws column_invalid");
+    check(selection_rejected(unknown_name) and selection_rejected(unknown_index), "a column that does not exist throws column_invalid");
+    filesystem::remove("check_columns.csv");
+}
+
+/**
+ * @brief An observer that counts the calls it gets for every stage (in the order of load_stage).
+ */
+struct counting_observer
+{
+    uint64_t begins[4] = {};
+    uint64_t progresses[4] = {};
+    uint64_t ends[4] = {};
+    uint64_t end_rows[4] = {}; // The rows reported by the last end of the stage
+
+    void stage_begin(const load_stage &stage) { begins[(uint64_t)stage]++; }
+    void stage_progress(const load_progress &progress) { progresses[(uint64_t)progress.stage]++; }
+    void stage_end(const load_progress &progress)
+    {
+        ends[(uint64_t)progress.stage]++;
+        end_rows[(uint64_t)progress.stage] = progress.rows;
+    }
+};
+
+/**
+ * @brief Reads a file with the cache, and tells whether the values came from the cache.
+ * @param values The values read.
+ */
+template <typename V>
+bool read_cached(const csv_options &options, matrix<V> &values)
+{
+    csv<V, allocator<V>, counting_observer> cached("check_cache.csv", options);
+    values = cached.read_data(false);
+    return cached.get_observer().ends[(uint64_t)load_stage::cache_load] == 1;
+}
+
+/**
+ * @brief Checks that the cache is used for the same file, selection and type, and is not used when one of them changes.
+ */
+void check_cache()
+{
+    write_file("check_cache.csv", "a,b\n1,2\n3,4\n");
+    filesystem::remove("check_cache.csv.cache");
+    csv_options options;
+    options.cache = true;
+    matrix<double> values(1, 1);
+    check(!read_cached(options, values) and filesystem::exists("check_cache.csv.cache") and values(1, 0) == 3, "cache: the first load parses and saves the cache");
+    check(read_cached(options, values) and values.get_rows() == 2 and values(0, 1) == 2 and values(1, 0) == 3, "cache: the second load is a hit");
+    csv<double> columns("check_cache.csv", options);
+    column_matrix<double> column_values = columns.read_columns(true);
+    check(column_values.get_cols() == 3 and column_values(1, 0) == 2 and column_values(1, 2) == 4, "cache: read_columns(true) from the cache");
+
+    // The same size and modification time, so only the contents tell that the file has changed
+    filesystem::file_time_type written = filesystem::last_write_time("check_cache.csv");
+    write_file("check_cache.csv", "a,b\n1,2\n5,4\n");
+    filesystem::last_write_time("check_cache.csv", written);
+    check(!read_cached(options, values) and values(1, 0) == 5, "cache: a file rewritten with the same size is parsed again");
+    check(read_cached(options, values) and values(1, 0) == 5, "cache: then the new cache is used");
+
+    csv_options selection = options;
+    selection.columns = {"b"};
+    check(!read_cached(selection, values) and values.get_cols() == 1 and values(1, 0) == 4, "cache: another selection is not read from the cache");
+    matrix<float> floats(1, 1);
+    check(!read_cached(options, floats) and floats(1, 0) == 5, "cache: another type is not read from the cache");
+    filesystem::remove("check_cache.csv");
+    filesystem::remove("check_cache.csv.cache");
+}
+
+/**
+ * @brief Checks that every stage reports its begin, its progress, and its end to the observer,
+ * and that errors are reported by the exceptions (with the file, line, or column) without printing anything.
+ */
+void check_observer()
+{
+    const uint64_t rows = 70000; // More than 65536 rows, so every stage reports its progress
+    string text = "a,b\n";
+    for (uint64_t i = 0; i < rows; i++)
+        text += to_string(i) + "," + to_string(i * 2) + "\n";
+    write_file("check_observer.csv", text);
+    filesystem::remove("check_observer.csv.cache");
+    csv_options options;
+    options.cache = true;
+    csv<double, allocator<double>, counting_observer> parsed("check_observer.csv", options);
+    parsed.read_data(false);
+    csv<double, allocator<double>, counting_observer> cached("check_observer.csv", options);
+    cached.read_data(true);
+    const counting_observer &first = parsed.get_observer();
+    const counting_observer &second = cached.get_observer();
+    vector<pair<load_stage, string>> stages = {{load_stage::open, "open"}, {load_stage::parse, "parse"}, {load_stage::cache_save, "cache_save"}, {load_stage::cache_load, "cache_load"}};
+    for (const auto &[stage, name] : stages)
+    {
+        const counting_observer &counts = (stage == load_stage::cache_load) ? second : first;
+        uint64_t k = (uint64_t)stage;
+        check(counts.begins[k] == 1 and counts.progresses[k] >= 1 and counts.ends[k] == 1 and counts.end_rows[k] == rows,
+              "observer: begin, progress, and end of " + name);
+    }
+    filesystem::remove("check_observer.csv");
+    filesystem::remove("check_observer.csv.cache");
+
+    // Nothing is printed: the messages of the exceptions tell where the problem is
+    stringstream printed;
+    streambuf *console = cout.rdbuf(printed.rdbuf());
+    vector<string> messages;
+    write_file("check_observer.csv", "a,b\n1,2\n\n3,4\n");
+    try
+    {
+        csv<double>("check_observer.csv");
+    }
+    catch (const csv<double>::empty_line &e)
+    {
+        messages.push_back(e.what());
+    }
+    try
+    {
+        csv_options missing;
+        missing.columns = {"z"};
+        csv<double>("check_observer.csv", missing);
+    }
+    catch (const csv<double>::column_invalid &e)
+    {
+        messages.push_back(e.what());
+    }
+    try
+    {
+        csv<double>("check_observer_missing.csv");
+    }
+    catch (const csv<double>::file_notfound &e)
+    {
+        messages.push_back(e.what());
+    }
+    cout.rdbuf(console);
+    filesystem::remove("check_observer.csv");
+    check(printed.str().empty() and messages.size() == 3 and messages[0].find("Line number 2 is empty") != string::npos and
+              messages[1].find("Column \"z\"") != string::npos and messages[2].find("File \"check_observer_missing.csv\"") != string::npos,
+          "errors are reported in the exceptions, and nothing is printed");
+}
+
+int main()
+{
+    /**
+     * @mainpage
+     * A sample run for 'ReadCSV' header.
+     * Reading a csv file, with only numeric values.
+     */
+    uint64_t Nrows, Ncols;
+    vector<double> Row_number;
+    string headers;
+
+    try
+    {
+        csv<double> my_dataset("all_number.csv");
+        Nrows = my_dataset.get_NRows();
+        Ncols = my_dataset.get_NCols();
+        headers = my_dataset.get_header();
+    }
+    catch (const exception &e)
+    {
+        cout << e.what();
+        return -1;
+    }
+    // Saving our data set into a matrix
+    matrix<double> MatrixData(Nrows, (Ncols + 1));
+    matrix<double> MatrixData2(Nrows, Ncols);
+    try
+    {
+        csv<double> my_dataset("all_number.csv");
+        MatrixData = my_dataset.read_data(false);
+        MatrixData2 = my_dataset.read_data(true);
+    }
+    catch (const exception &e)
+    {
+        cout << e.what();
+        return -1;
+    }
+    cout << "\nHeaders: " << headers << "\n\n";
+    cout << "\nWithout row numbers:" << MatrixData;
+    cout << "\nWith row numbers:" << MatrixData2 << "\n\n";
+
+    try
+    {
+        check_multiply();
+        check_expressions();
+        check_numbers();
+        check_batches();
+        check_projection();
+        check_table();
+        check_cache();
+        check_observer();
+        check_get_rows();
+        check_refresh();
+        check_dialects();
+        check_error_modes();
+        check_writer();
+#ifdef READCSV_USE_ZLIB
+        check_gzip();
+        check_gzip_refresh();
+#endif
+    }
+    catch (const exception &e)
+    {
+        cout << e.what();
+        return -1;
+    }
+    if (failed_checks > 0)
+    {
+        cout << failed_checks << " checks failed!\n";
+        return -1;
+    }
+    cout << "\n";
+
+    try
+    {
+        csv<double> my_dataset("anything.csv");
+    }
+    catch (const exception &e)
+    {
+        cout << e.what();
+        return -1;
+    }
+
+    cout << "This line will NOT be printed!\n";
+}